@@ -50,6 +50,8 @@ private:
 class MessageBuilder : public capnp::MallocMessageBuilder {
 public:
   MessageBuilder() = default;
+  // first_segment must be zeroed, the builder zeroes it again when destroyed so it can be reused for the next message
+  explicit MessageBuilder(kj::ArrayPtr<capnp::word> first_segment) : capnp::MallocMessageBuilder(first_segment) {}
 
   cereal::Event::Builder initEvent(bool valid = true) {
     cereal::Event::Builder event = initRoot<cereal::Event>();
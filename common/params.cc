@@ -234,13 +234,31 @@ ParamKeyType Params::getKeyType(const std::string &key) {
 }
 
 int Params::put(const char* key, const char* value, size_t value_size) {
+  Transaction t(*this);
+  int result = t.put(key, value, value_size);
+  return result == 0 ? t.commit() : result;
+}
+
+int Params::putMany(const std::map<std::string, std::string> &values) {
+  Transaction t(*this);
+  for (const auto &[key, value] : values) {
+    if (int result = t.put(key, value); result != 0) return result;
+  }
+  return t.commit();
+}
+
+Params::Transaction::~Transaction() {
+  discard();
+}
+
+int Params::Transaction::put(const char* key, const char* value, size_t value_size) {
   // Information about safely and atomically writing a file: https://lwn.net/Articles/457667/
   // 1) Create temp file
   // 2) Write data to temp file
   // 3) fsync() the temp file
-  // 4) rename the temp file to the real name
-  // 5) fsync() the containing directory
-  std::string tmp_path = params_path + "/.tmp_value_XXXXXX";
+  // 4) rename the temp file to the real name, in commit()
+  // 5) fsync() the containing directory, once for all values
+  std::string tmp_path = params.params_path + "/.tmp_value_XXXXXX";
   int tmp_fd = mkstemp((char*)tmp_path.c_str());
   if (tmp_fd < 0) return -1;
 
@@ -254,24 +272,48 @@ int Params::put(const char* key, const char* value, size_t value_size) {
     }
 
     // fsync to force persist the changes.
-    if ((result = fsync(tmp_fd)) < 0) break;
-
-    FileLock file_lock(params_path + "/.lock");
-
-    // Move temp into place.
-    if ((result = rename(tmp_path.c_str(), getParamPath(key).c_str())) < 0) break;
-
-    // fsync parent directory
-    result = fsync_dir(getParamPath());
+    result = fsync(tmp_fd);
   } while (false);
 
   close(tmp_fd);
   if (result != 0) {
     ::unlink(tmp_path.c_str());
+    return result;
   }
+  staged.push_back({tmp_path, key});
+  return 0;
+}
+
+int Params::Transaction::commit() {
+  if (staged.empty()) return 0;
+
+  int result = 0;
+  {
+    FileLock file_lock(params.params_path + "/.lock");
+
+    // Move temps into place.
+    size_t renamed = 0;
+    while (renamed < staged.size() &&
+           (result = rename(staged[renamed].first.c_str(), params.getParamPath(staged[renamed].second).c_str())) == 0) {
+      ++renamed;
+    }
+    staged.erase(staged.begin(), staged.begin() + renamed);
+
+    // fsync parent directory, even after a failed rename the moved values are synced
+    int sync_result = fsync_dir(params.getParamPath());
+    result = result != 0 ? result : sync_result;
+  }
+  discard();
   return result;
 }
 
+void Params::Transaction::discard() {
+  for (const auto &[tmp_path, key] : staged) {
+    ::unlink(tmp_path.c_str());
+  }
+  staged.clear();
+}
+
 int Params::remove(const std::string &key) {
   FileLock file_lock(params_path + "/.lock");
   int result = unlink(getParamPath(key).c_str());
@@ -58,6 +58,33 @@ public:
     putNonBlocking(key, val ? "1" : "0");
   }
 
+  // Writes many values taking the lock and syncing the directory once. put stages each value in a synced
+  // temp file, commit moves them all into place. Each value is replaced atomically, but readers may see
+  // some of the new values before the others. Uncommitted values are discarded.
+  class Transaction {
+  public:
+    explicit Transaction(Params &params) : params(params) {}
+    ~Transaction();
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    int put(const char *key, const char *val, size_t value_size);
+    inline int put(const std::string &key, const std::string &val) {
+      return put(key.c_str(), val.data(), val.size());
+    }
+    inline int putBool(const std::string &key, bool val) {
+      return put(key.c_str(), val ? "1" : "0", 1);
+    }
+    int commit();
+
+  private:
+    void discard();
+
+    Params &params;
+    std::vector<std::pair<std::string, std::string>> staged;  // temp path, key
+  };
+  int putMany(const std::map<std::string, std::string> &values);
+
 private:
   void asyncWriteThread();
 
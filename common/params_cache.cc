@@ -0,0 +1,108 @@
+#include "common/params_cache.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "common/swaglog.h"
+#include "common/util.h"
+
+ParamsCache::ParamsCache(const std::string &path) : params(path) {
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_CLOEXEC);
+  exit_fd = eventfd(0, EFD_CLOEXEC);
+  // put renames a temp file into place, remove and clearAll unlink
+  if (inotify_fd < 0 || exit_fd < 0 ||
+      inotify_add_watch(inotify_fd, params.getParamPath().c_str(), IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE) < 0) {
+    LOGE("Failed to watch params path %s, errno=%d", params.getParamPath().c_str(), errno);
+  } else {
+    thread = std::thread(&ParamsCache::watchThread, this);
+  }
+#endif
+}
+
+ParamsCache::~ParamsCache() {
+  if (thread.joinable()) {
+    uint64_t exit = 1;
+    [[maybe_unused]] ssize_t ret = HANDLE_EINTR(write(exit_fd, &exit, sizeof(exit)));
+    thread.join();
+  }
+  if (inotify_fd >= 0) close(inotify_fd);
+  if (exit_fd >= 0) close(exit_fd);
+}
+
+std::string ParamsCache::get(const std::string &key) {
+  if (!watching()) return params.get(key);
+
+  std::lock_guard lk(lock);
+  auto it = values.find(key);
+  if (it == values.end()) {
+    // read under the lock, a change the watcher sees meanwhile can't be overwritten by the older value
+    it = values.emplace(key, params.get(key)).first;
+  }
+  return it->second;
+}
+
+void ParamsCache::onChange(const std::string &key, Callback callback) {
+  std::lock_guard lk(lock);
+  callbacks[key].push_back(callback);
+  if (watching() && values.find(key) == values.end()) {
+    values.emplace(key, params.get(key));
+  }
+}
+
+void ParamsCache::refresh(const std::string &key) {
+  std::string value;
+  std::vector<Callback> changed;
+  {
+    std::lock_guard lk(lock);
+    auto it = values.find(key);
+    // params that were never read aren't cached
+    if (it == values.end()) return;
+
+    value = params.get(key);
+    if (value == it->second) return;
+    it->second = value;
+    if (auto cb = callbacks.find(key); cb != callbacks.end()) {
+      changed = cb->second;
+    }
+  }
+  for (const auto &callback : changed) {
+    callback(key, value);
+  }
+}
+
+void ParamsCache::watchThread() {
+#ifdef __linux__
+  util::set_thread_name("params_cache");
+
+  alignas(struct inotify_event) char buf[4096];
+  struct pollfd fds[] = {{.fd = inotify_fd, .events = POLLIN}, {.fd = exit_fd, .events = POLLIN}};
+  while (true) {
+    if (HANDLE_EINTR(poll(fds, std::size(fds), -1)) < 0 || fds[1].revents) break;
+
+    ssize_t len = HANDLE_EINTR(read(inotify_fd, buf, sizeof(buf)));
+    for (char *p = buf; len > 0 && p < buf + len;) {
+      auto event = (const struct inotify_event *)p;
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // events were lost, check every cached value
+        std::vector<std::string> keys;
+        {
+          std::lock_guard lk(lock);
+          for (const auto &[key, _] : values) keys.push_back(key);
+        }
+        for (const auto &key : keys) refresh(key);
+      } else if (event->len > 0 && event->name[0] != '.') {
+        // skip the temp files and the lock
+        refresh(event->name);
+      }
+    }
+  }
+#endif
+}
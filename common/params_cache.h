@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/params.h"
+
+// Keeps the params that were read in memory, for code that polls them in a loop. A thread watches the params
+// directory with inotify and re-reads only the values that changed, so get() is a map lookup instead of a file read.
+// Without inotify (macOS) every get() reads the file.
+class ParamsCache {
+public:
+  explicit ParamsCache(const std::string &path = {});
+  ~ParamsCache();
+  ParamsCache(const ParamsCache&) = delete;
+  ParamsCache& operator=(const ParamsCache&) = delete;
+
+  std::string get(const std::string &key);
+  inline bool getBool(const std::string &key) {
+    return get(key) == "1";
+  }
+
+  // false if the params directory couldn't be watched and every get() reads the file
+  bool watching() const { return thread.joinable(); }
+
+  // called from the watcher thread with the new value, empty if the param was removed
+  typedef std::function<void(const std::string &key, const std::string &value)> Callback;
+  void onChange(const std::string &key, Callback callback);
+
+private:
+  void watchThread();
+  void refresh(const std::string &key);
+
+  Params params;
+  int inotify_fd = -1;
+  int exit_fd = -1;
+
+  std::mutex lock;
+  std::unordered_map<std::string, std::string> values;
+  std::unordered_map<std::string, std::vector<Callback>> callbacks;
+  std::thread thread;
+};
@@ -1,6 +1,7 @@
 # distutils: language = c++
 # cython: language_level = 3
 from libcpp cimport bool
+from libcpp.map cimport map
 from libcpp.string cimport string
 from libcpp.vector cimport vector
 
@@ -19,6 +20,7 @@ cdef extern from "common/params.h":
     bool getBool(string, bool) nogil
     int remove(string) nogil
     int put(string, string) nogil
+    int putMany(map[string, string]) nogil
     void putNonBlocking(string, string) nogil
     void putBoolNonBlocking(string, bool) nogil
     int putBool(string, bool) nogil
@@ -89,6 +91,17 @@ cdef class Params:
     with nogil:
       self.p.put(k, dat_bytes)
 
+  def put_many(self, values):
+    """
+    Writes a dict of values with a single directory sync, much faster than calling put for each.
+    Blocks like put.
+    """
+    cdef map[string, string] vals
+    for k, v in values.items():
+      vals[self.check_key(k)] = ensure_bytes(v)
+    with nogil:
+      self.p.putMany(vals)
+
   def put_bool(self, key, bool val):
     cdef string k = self.check_key(key)
     with nogil:
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 template <class T>
 class SafeQueue {
@@ -50,3 +52,48 @@ private:
   std::condition_variable cv;
   std::queue<T> q;
 };
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+template <class T>
+class SPSCQueue {
+public:
+  // capacity is rounded up to a power of two
+  explicit SPSCQueue(size_t capacity) {
+    size_t n = 1;
+    while (n < capacity) n <<= 1;
+    buf.resize(n);
+    mask = n - 1;
+  }
+
+  // producer, returns false if the queue is full
+  bool push(const T& v) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail_cache > mask) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (h - tail_cache > mask) return false;
+    }
+    buf[h & mask] = v;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer, appends all available items to out and returns their number
+  size_t pop_all(std::vector<T>& out) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    const size_t h = head.load(std::memory_order_acquire);
+    for (size_t i = t; i != h; ++i) {
+      out.push_back(buf[i & mask]);
+    }
+    tail.store(h, std::memory_order_release);
+    return h - t;
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+private:
+  alignas(64) std::atomic<size_t> head = 0;
+  size_t tail_cache = 0;  // producer's copy of tail
+  alignas(64) std::atomic<size_t> tail = 0;
+  size_t mask;
+  std::vector<T> buf;
+};
@@ -1,6 +1,13 @@
+#include <chrono>
+#include <cstdio>
+
+#include <dirent.h>
+#include <unistd.h>
+
 #include "catch2/catch.hpp"
 #define private public
 #include "common/params.h"
+#include "common/params_cache.h"
 #include "common/util.h"
 
 TEST_CASE("params_nonblocking_put") {
@@ -25,3 +32,119 @@ TEST_CASE("params_nonblocking_put") {
     REQUIRE(p.get(name) == "1");
   }
 }
+
+// the temp files of Transaction::put are staged next to the params directory
+int count_temp_files(const std::string &params_path) {
+  int count = 0;
+  if (DIR *d = opendir(params_path.c_str())) {
+    while (struct dirent *de = readdir(d)) {
+      count += util::starts_with(de->d_name, ".tmp_value_");
+    }
+    closedir(d);
+  }
+  return count;
+}
+
+TEST_CASE("params_transaction") {
+  char tmp_path[] = "/tmp/params_transaction_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params params(param_path);
+  params.put("IsMetric", "0");
+
+  {
+    Params::Transaction t(params);
+    REQUIRE(t.put("CarParams", "1") == 0);
+    REQUIRE(t.putBool("IsMetric", true) == 0);
+    // staged values aren't visible before the commit
+    REQUIRE(params.get("CarParams").empty());
+    REQUIRE(params.get("IsMetric") == "0");
+    REQUIRE(t.commit() == 0);
+  }
+  REQUIRE(params.get("CarParams") == "1");
+  REQUIRE(params.getBool("IsMetric"));
+
+  {
+    Params::Transaction t(params);
+    REQUIRE(t.put("CarParams", "2") == 0);
+    REQUIRE(count_temp_files(params.params_path) == 1);
+  }
+  // discarded without a commit, and no temp files are left behind
+  REQUIRE(params.get("CarParams") == "1");
+  REQUIRE(params.readAll().size() == 2);
+  REQUIRE(count_temp_files(params.params_path) == 0);
+
+  REQUIRE(params.putMany({{"CarParams", "3"}, {"CarParamsPersistent", "3"}}) == 0);
+  REQUIRE(params.get("CarParams") == "3");
+  REQUIRE(params.get("CarParamsPersistent") == "3");
+  REQUIRE(params.readAll().size() == 3);
+}
+
+TEST_CASE("params_cache") {
+  char tmp_path[] = "/tmp/params_cache_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params params(param_path);
+  params.putBool("IsMetric", false);
+
+  ParamsCache cache(param_path);
+  REQUIRE(cache.watching());
+  REQUIRE_FALSE(cache.getBool("IsMetric"));
+  REQUIRE(cache.get("CarParams").empty());
+
+  std::mutex lock;
+  std::vector<std::pair<std::string, std::string>> changes;
+  cache.onChange("IsMetric", [&](const std::string &key, const std::string &value) {
+    std::lock_guard lk(lock);
+    changes.push_back({key, value});
+  });
+  auto wait_for = [&](auto condition) {
+    for (int i = 0; i < 200 && !condition(); ++i) util::sleep_for(5);
+    return condition();
+  };
+
+  // put, putMany and remove are all seen
+  params.putBool("IsMetric", true);
+  REQUIRE(wait_for([&]() { return cache.getBool("IsMetric"); }));
+  params.putMany({{"IsMetric", "0"}, {"CarParams", "1"}});
+  REQUIRE(wait_for([&]() { return cache.get("CarParams") == "1"; }));
+  REQUIRE(wait_for([&]() { return !cache.getBool("IsMetric"); }));
+  params.remove("CarParams");
+  REQUIRE(wait_for([&]() { return cache.get("CarParams").empty(); }));
+
+  // writing the same value again isn't a change
+  params.putBool("IsMetric", false);
+  params.putBool("IsMetric", true);
+  REQUIRE(wait_for([&]() { std::lock_guard lk(lock); return changes.size() == 3; }));
+  std::lock_guard lk(lock);
+  REQUIRE(changes == std::vector<std::pair<std::string, std::string>>{{"IsMetric", "1"}, {"IsMetric", "0"}, {"IsMetric", "1"}});
+}
+
+TEST_CASE("params put benchmark", "[.][benchmark]") {
+  // set PARAMS_ROOT to measure on the device's storage
+  const std::string root = util::getenv("PARAMS_ROOT", "/tmp");
+  const std::string param_path = util::string_format("%s/params_benchmark_%d", root.c_str(), getpid());
+  Params params(param_path);
+  const std::vector<std::string> keys = params.allKeys();
+  const std::string value(256, 'x');
+
+  for (int batch : {1, 10, (int)keys.size()}) {
+    const int n = keys.size() / batch * batch;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      params.put(keys[i], value);
+    }
+    double put_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i += batch) {
+      Params::Transaction t(params);
+      for (int j = i; j < i + batch; ++j) {
+        t.put(keys[j], value);
+      }
+      t.commit();
+    }
+    double transaction_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%3d keys per transaction: put %8.0f keys/s, transaction %8.0f keys/s\n", batch, n / put_s, n / transaction_s);
+  }
+  params.clearAll(ALL);
+}
@@ -40,6 +40,16 @@ class TestParams:
     assert self.params.get("DongleId") == b"bob"
     assert self.params.get("AthenadPid") == b"123"
 
+  def test_params_put_many(self):
+    self.params.put_many({"DongleId": "bob", "AthenadPid": b"123", "IsMetric": "1"})
+    assert self.params.get("DongleId") == b"bob"
+    assert self.params.get("AthenadPid") == b"123"
+    assert self.params.get_bool("IsMetric")
+
+    with pytest.raises(UnknownKeyName):
+      self.params.put_many({"DongleId": "alice", "swag": "abc"})
+    assert self.params.get("DongleId") == b"bob"
+
   def test_params_get_block(self):
     def _delayed_writer():
       time.sleep(0.1)
@@ -6,10 +6,14 @@
 #include <algorithm>
 #include <climits>
 #include <fstream>
+#include <numeric>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "catch2/catch.hpp"
+#include "common/queue.h"
 #include "common/util.h"
 
 std::string random_bytes(int size) {
@@ -145,3 +149,29 @@ TEST_CASE("util::create_directories") {
     REQUIRE(util::create_directories("", 0755) == false);
   }
 }
+
+TEST_CASE("SPSCQueue") {
+  SPSCQueue<int> q(1000);
+  REQUIRE(q.capacity() == 1024);
+
+  const int count = 1000000;
+  std::thread producer([&]() {
+    for (int i = 0; i < count;) {
+      if (q.push(i)) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::vector<int> received;
+  while (received.size() < count) {
+    if (q.pop_all(received) == 0) std::this_thread::yield();
+  }
+  producer.join();
+
+  std::vector<int> expected(count);
+  std::iota(expected.begin(), expected.end(), 0);
+  REQUIRE(received == expected);
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Per-stage latency of camera frames from camerad to the log, e.g. ./frame_latency.py "<route>/0"
+import argparse
+import numpy as np
+from collections import defaultdict
+
+from openpilot.tools.lib.logreader import LogReader
+
+CAMERA_STATES = {
+  "roadEncodeIdx": "roadCameraState",
+  "qRoadEncodeIdx": "roadCameraState",
+  "wideRoadEncodeIdx": "wideRoadCameraState",
+  "driverEncodeIdx": "driverCameraState",
+}
+
+# stage: (start, end) timestamps, camera timestamps are prefixed with camera.
+STAGES = {
+  "readout": ("camera.timestampSof", "camera.timestampEof"),
+  "camerad": ("camera.timestampEof", "camera.timestampSent"),
+  "visionipc": ("camera.timestampSent", "timestampReceived"),
+  "encoder queue": ("timestampReceived", "timestampEncodeStart"),
+  "encode": ("timestampEncodeStart", "timestampEncodeEnd"),
+  "publish": ("timestampEncodeEnd", "timestampPublished"),
+  "loggerd": ("timestampPublished", "timestampLogged"),
+  "total": ("camera.timestampEof", "timestampLogged"),
+}
+
+
+def timestamp(name, idx, camera):
+  if name.startswith("camera."):
+    return getattr(camera, name[len("camera."):]) if camera is not None else 0
+  return getattr(idx, name)
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Per-stage latency of camera frames from camerad to the log")
+  parser.add_argument("route", help="route or segment, rlogs are needed for the camera states")
+  args = parser.parse_args()
+
+  cameras: dict[str, dict[int, object]] = defaultdict(dict)
+  idxs: dict[str, list] = defaultdict(list)
+  for msg in LogReader(args.route):
+    which = msg.which()
+    if which in CAMERA_STATES.values():
+      cameras[which][getattr(msg, which).frameId] = getattr(msg, which)
+    elif which in CAMERA_STATES:
+      idxs[which].append(getattr(msg, which))
+
+  for encoder, frames in sorted(idxs.items()):
+    camera_frames = cameras[CAMERA_STATES[encoder]]
+    latencies = defaultdict(list)
+    for idx in frames:
+      camera = camera_frames.get(idx.frameId)
+      for stage, (start, end) in STAGES.items():
+        t0, t1 = timestamp(start, idx, camera), timestamp(end, idx, camera)
+        if t0 > 0 and t1 > 0:
+          latencies[stage].append((t1 - t0) / 1e6)
+
+    logged = {idx.frameId for idx in frames}
+    if camera_frames:
+      # frames that reached the log, only counted between the first and last logged frame
+      first, last = min(logged), max(logged)
+      sent = [f for f in camera_frames if first <= f <= last]
+      print(f"{encoder}: {len(frames)} frames, {len(sent) - len(logged & set(sent))} of {len(sent)} camera frames missing")
+    else:
+      print(f"{encoder}: {len(frames)} frames, no camera states")
+
+    print(f"  {'stage':15} {'p50':>8} {'p90':>8} {'p99':>8} {'max':>8}   ms")
+    for stage in STAGES:
+      if len(latencies[stage]) == 0:
+        print(f"  {stage:15} {'-':>8}")
+        continue
+      p50, p90, p99 = np.percentile(latencies[stage], [50, 90, 99])
+      print(f"  {stage:15} {p50:8.2f} {p90:8.2f} {p99:8.2f} {max(latencies[stage]):8.2f}")
+    print()
@@ -14,6 +14,7 @@
 #include "cereal/gen/cpp/car.capnp.h"
 #include "cereal/messaging/messaging.h"
 #include "common/params.h"
+#include "common/params_cache.h"
 #include "common/ratekeeper.h"
 #include "common/swaglog.h"
 #include "common/timing.h"
@@ -407,7 +408,8 @@ void send_peripheral_state(PubMaster *pm, Panda *panda) {
 void panda_state_thread(std::vector<Panda *> pandas, bool spoofing_started) {
   util::set_thread_name("pandad_panda_state");
 
-  Params params;
+  // polled at 10hz
+  ParamsCache params;
   SubMaster sm({"controlsState"});
   PubMaster pm({"pandaStates", "peripheralState"});
 
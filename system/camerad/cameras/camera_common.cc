@@ -128,6 +128,7 @@ bool CameraBuf::acquire() {
     cur_frame_data.timestamp_eof,
   };
   cur_yuv_buf->set_frame_id(cur_frame_data.frame_id);
+  cur_frame_data.timestamp_sent = nanos_since_boot();
   vipc_server->send(cur_yuv_buf, &extra);
 
   return true;
@@ -144,6 +145,7 @@ void fill_frame_data(cereal::FrameData::Builder &framed, const FrameMetadata &fr
   framed.setRequestId(frame_data.request_id);
   framed.setTimestampEof(frame_data.timestamp_eof);
   framed.setTimestampSof(frame_data.timestamp_sof);
+  framed.setTimestampSent(frame_data.timestamp_sent);
   framed.setIntegLines(frame_data.integ_lines);
   framed.setGain(frame_data.gain);
   framed.setHighConversionGain(frame_data.high_conversion_gain);
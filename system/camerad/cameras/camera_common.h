@@ -32,6 +32,7 @@ typedef struct FrameMetadata {
   // Timestamps
   uint64_t timestamp_sof;
   uint64_t timestamp_eof;
+  uint64_t timestamp_sent;
 
   // Exposure
   unsigned int integ_lines;
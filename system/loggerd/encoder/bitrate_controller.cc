@@ -0,0 +1,44 @@
+#include "system/loggerd/encoder/bitrate_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+double BitrateController::update(const Inputs &in) {
+  const double minutes_left = in.output_rate > 0 ? in.free_bytes / in.output_rate / 60. : INFINITY;
+  const double prev_scale = scale_;
+  double next_scale = prev_scale;
+  const char *reason = "ok";
+  bool healthy = false;
+  if (in.free_bytes < CRITICAL_FREE_BYTES) {
+    next_scale = MIN_SCALE;
+    reason = "storage critical";
+  } else if (in.free_bytes < LOW_FREE_BYTES || minutes_left < MIN_MINUTES_LEFT) {
+    next_scale = prev_scale * STEP;
+    reason = "storage low";
+  } else if (in.slow_writes > MAX_SLOW_WRITES) {
+    next_scale = prev_scale * STEP;
+    reason = "loggerd writes falling behind";
+  } else {
+    healthy = true;
+    if (prev_scale < 1.0 && ++healthy_updates >= RECOVERY_UPDATES) {
+      next_scale = prev_scale / STEP;
+      reason = "recovered";
+    }
+  }
+  next_scale = std::clamp(next_scale, MIN_SCALE, 1.0);
+  if (!healthy || next_scale != prev_scale) healthy_updates = 0;
+
+  if (next_scale != prev_scale) {
+    LOGW("bitrate scale %.2f -> %.2f, %s: %.2f GB free, %.0f min left at %.2f MB/s, %llu slow writes",
+         prev_scale, next_scale, reason, in.free_bytes / 1e9, minutes_left, in.output_rate / 1e6, (unsigned long long)in.slow_writes);
+  } else {
+    LOG("bitrate scale %.2f, %s: %.2f GB free, %.0f min left at %.2f MB/s, %llu slow writes",
+        next_scale, reason, in.free_bytes / 1e9, minutes_left, in.output_rate / 1e6, (unsigned long long)in.slow_writes);
+  }
+  scale_ = next_scale;
+  return next_scale;
+}
+
+int BitrateController::bitrate(const EncoderInfo &encoder_info) const {
+  return std::max<int>(encoder_info.min_bitrate, encoder_info.bitrate * scale_);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "system/loggerd/loggerd.h"
+
+// Scales the bitrate of the logged encoders down when storage runs low or loggerd can't keep up with writing,
+// and back up once that recovers. Each encoder stays within [min_bitrate, bitrate] of its EncoderInfo and picks
+// up a new bitrate when it opens the next segment.
+class BitrateController {
+public:
+  struct Inputs {
+    uint64_t free_bytes;
+    double output_rate;    // bytes/s written by the encoders since the last update
+    uint64_t slow_writes;  // loggerd writes that blocked for 2^SLOW_WRITE_BUCKET ms or more since the last update
+  };
+
+  // called about once per segment
+  double update(const Inputs &in);
+  int bitrate(const EncoderInfo &encoder_info) const;
+  double scale() const { return scale_; }
+
+  static constexpr double MIN_SCALE = 0.25;
+  static constexpr double STEP = 0.75;
+  // the deleter keeps 5 GB free, less than this means it's falling behind or everything left is preserved
+  static constexpr uint64_t LOW_FREE_BYTES = 3ULL * 1024 * 1024 * 1024;
+  static constexpr uint64_t CRITICAL_FREE_BYTES = 1ULL * 1024 * 1024 * 1024;
+  static constexpr double MIN_MINUTES_LEFT = 10;
+  static constexpr int SLOW_WRITE_BUCKET = 6;  // 64ms, see loggerStats.writeStalls
+  static constexpr uint64_t MAX_SLOW_WRITES = 10;
+  static constexpr int RECOVERY_UPDATES = 3;  // healthy updates in a row before stepping back up
+
+private:
+  std::atomic<double> scale_ = 1.0;
+  int healthy_updates = 0;
+};
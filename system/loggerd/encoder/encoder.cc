@@ -1,21 +1,127 @@
 #include "system/loggerd/encoder/encoder.h"
 
+#include "third_party/libyuv/include/libyuv.h"
+
+std::vector<uint8_t> EncoderBufferPool::get(size_t size) {
+  std::lock_guard lk(lock);
+  for (auto it = free_bufs.begin(); it != free_bufs.end(); ++it) {
+    if (it->size() == size) {
+      std::vector<uint8_t> buf = std::move(*it);
+      free_bufs.erase(it);
+      return buf;
+    }
+  }
+  return std::vector<uint8_t>(size);
+}
+
+void EncoderBufferPool::put(std::vector<uint8_t> &&buf) {
+  std::lock_guard lk(lock);
+  if (free_bufs.size() >= MAX_FREE) {
+    free_bufs.erase(free_bufs.begin());
+  }
+  free_bufs.push_back(std::move(buf));
+}
+
+EncoderFrame::~EncoderFrame() {
+  if (!pool) return;
+  for (auto *bufs : {&planes, &nv12_planes}) {
+    for (auto &[size, plane] : *bufs) pool->put(std::move(plane));
+  }
+}
+
+const uint8_t *EncoderFrame::i420(int width, int height) {
+  std::lock_guard lk(lock);
+  auto it = planes.find({width, height});
+  if (it != planes.end()) return it->second.data();
+
+  const int in_width = buf->width, in_height = buf->height;
+  auto full = planes.find({in_width, in_height});
+  if (full == planes.end()) {
+    std::vector<uint8_t> converted = alloc(in_width * in_height * 3 / 2);
+    uint8_t *y = converted.data();
+    uint8_t *u = y + in_width * in_height;
+    uint8_t *v = u + (in_width / 2) * (in_height / 2);
+    libyuv::NV12ToI420(buf->y, buf->stride,
+                       buf->uv, buf->stride,
+                       y, in_width,
+                       u, in_width/2,
+                       v, in_width/2,
+                       in_width, in_height);
+    // don't keep a conversion of a half overwritten frame
+    if (!valid()) {
+      if (pool) pool->put(std::move(converted));
+      return nullptr;
+    }
+    full = planes.emplace(std::make_pair(in_width, in_height), std::move(converted)).first;
+  }
+  if (width == in_width && height == in_height) return full->second.data();
+
+  std::vector<uint8_t> out = alloc(width * height * 3 / 2);
+  const uint8_t *in_y = full->second.data();
+  const uint8_t *in_u = in_y + in_width * in_height;
+  const uint8_t *in_v = in_u + (in_width / 2) * (in_height / 2);
+  uint8_t *y = out.data();
+  uint8_t *u = y + width * height;
+  uint8_t *v = u + (width / 2) * (height / 2);
+  libyuv::I420Scale(in_y, in_width,
+                    in_u, in_width/2,
+                    in_v, in_width/2,
+                    in_width, in_height,
+                    y, width,
+                    u, width/2,
+                    v, width/2,
+                    width, height,
+                    libyuv::kFilterNone);
+  return planes.emplace(std::make_pair(width, height), std::move(out)).first->second.data();
+}
+
+const uint8_t *EncoderFrame::nv12(int width, int height) {
+  std::lock_guard lk(lock);
+  auto it = nv12_planes.find({width, height});
+  if (it != nv12_planes.end()) return it->second.data();
+
+  std::vector<uint8_t> out = alloc(width * height * 3 / 2);
+  libyuv::ScalePlane(buf->y, buf->stride, buf->width, buf->height,
+                     out.data(), width, width, height, libyuv::kFilterNone);
+  // point sampling the UV plane as 16 bit pixels keeps each U,V pair together
+  libyuv::ScalePlane_16((const uint16_t *)buf->uv, buf->stride / 2, buf->width / 2, buf->height / 2,
+                        (uint16_t *)(out.data() + width * height), width / 2, width / 2, height / 2,
+                        libyuv::kFilterNone);
+  if (!valid()) {
+    if (pool) pool->put(std::move(out));
+    return nullptr;
+  }
+  return nv12_planes.emplace(std::make_pair(width, height), std::move(out)).first->second.data();
+}
+
 VideoEncoder::VideoEncoder(const EncoderInfo &encoder_info, int in_width, int in_height)
-    : encoder_info(encoder_info), in_width(in_width), in_height(in_height) {
+    : encoder_info(encoder_info), in_width(in_width), in_height(in_height), bitrate(encoder_info.bitrate) {
 
   out_width = encoder_info.frame_width > 0 ? encoder_info.frame_width : in_width;
   out_height = encoder_info.frame_height > 0 ? encoder_info.frame_height : in_height;
+}
 
-
-  std::vector pubs = {encoder_info.publish_name};
-  if (encoder_info.thumbnail_name != NULL) {
-    pubs.push_back(encoder_info.thumbnail_name);
+// created on first use, encoders with an output never publish
+PubMaster *VideoEncoder::publisher() {
+  if (!pm) {
+    std::vector pubs = {encoder_info.publish_name};
+    if (encoder_info.thumbnail_name != NULL) {
+      pubs.push_back(encoder_info.thumbnail_name);
+    }
+    pm.reset(new PubMaster(pubs));
   }
-  pm.reset(new PubMaster(pubs));
+  return pm.get();
+}
+
+void VideoEncoder::trace_encode_start(const EncoderFrame *input) {
+  std::lock_guard lk(trace_lock);
+  traces[input->extra.frame_id] = {input->timestamp_received, nanos_since_boot()};
 }
 
 void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t idx, VisionIpcBufExtra &extra,
                                      unsigned int flags, kj::ArrayPtr<capnp::byte> header, kj::ArrayPtr<capnp::byte> dat) {
+  const uint64_t encode_end = nanos_since_boot();
+
   // broadcast packet
   MessageBuilder msg;
   auto event = msg.initEvent(true);
@@ -38,13 +144,30 @@ void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t
   edat.setHeight(out_height);
   if (flags & V4L2_BUF_FLAG_KEYFRAME) edat.setHeader(header);
 
-  uint32_t bytes_size = capnp::computeSerializedSizeInWords(msg) * sizeof(capnp::word);
-  if (e->msg_cache.size() < bytes_size) {
-    e->msg_cache.resize(bytes_size);
+  {
+    std::lock_guard lk(e->trace_lock);
+    auto it = e->traces.find(extra.frame_id);
+    if (it != e->traces.end()) {
+      edata.setTimestampReceived(it->second.first);
+      edata.setTimestampEncodeStart(it->second.second);
+    }
+    // drop this and older frames, including the ones the encoder skipped
+    e->traces.erase(e->traces.begin(), e->traces.upper_bound(extra.frame_id));
+  }
+  edata.setTimestampEncodeEnd(encode_end);
+  edata.setTimestampPublished(nanos_since_boot());
+
+  if (e->output) {
+    e->output(msg);
+  } else {
+    uint32_t bytes_size = capnp::computeSerializedSizeInWords(msg) * sizeof(capnp::word);
+    if (e->msg_cache.size() < bytes_size) {
+      e->msg_cache.resize(bytes_size);
+    }
+    kj::ArrayOutputStream output_stream(kj::ArrayPtr<capnp::byte>(e->msg_cache.data(), bytes_size));
+    capnp::writeMessage(output_stream, msg);
+    e->publisher()->send(e->encoder_info.publish_name, e->msg_cache.data(), bytes_size);
   }
-  kj::ArrayOutputStream output_stream(kj::ArrayPtr<capnp::byte>(e->msg_cache.data(), bytes_size));
-  capnp::writeMessage(output_stream, msg);
-  e->pm->send(e->encoder_info.publish_name, e->msg_cache.data(), bytes_size);
 
   // Publish keyframe thumbnail
   if ((flags & V4L2_BUF_FLAG_KEYFRAME) && e->encoder_info.thumbnail_name != NULL) {
@@ -54,6 +177,10 @@ void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t
     thumbnail.setTimestampEof(extra.timestamp_eof);
     thumbnail.setThumbnail(dat);
     thumbnail.setEncoding(cereal::Thumbnail::Encoding::KEYFRAME);
-    pm->send(e->encoder_info.thumbnail_name, tm);
+    if (e->output) {
+      e->output(tm);
+    } else {
+      e->publisher()->send(e->encoder_info.thumbnail_name, tm);
+    }
   }
 }
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "cereal/messaging/messaging.h"
@@ -14,26 +18,80 @@
 
 #define V4L2_BUF_FLAG_KEYFRAME 8
 
+// Keeps the plane buffers of released frames, the conversions of a camera need the same few sizes every frame.
+class EncoderBufferPool {
+public:
+  std::vector<uint8_t> get(size_t size);
+  void put(std::vector<uint8_t> &&buf);
+
+private:
+  static constexpr int MAX_FREE = 8;
+  std::mutex lock;
+  std::vector<std::vector<uint8_t>> free_bufs;
+};
+
+// A camera frame shared by all encoders of the camera. Conversions are done once per output size,
+// by the first encoder that needs them.
+class EncoderFrame {
+public:
+  EncoderFrame(VisionBuf *buf, const VisionIpcBufExtra &extra, uint64_t received = 0,
+               std::shared_ptr<EncoderBufferPool> pool = nullptr)
+      : buf(buf), extra(extra), timestamp_received(received), pool(pool) {}
+  ~EncoderFrame();
+  // false if camerad already reused the buffer for a later frame
+  bool valid() const { return buf->get_frame_id() == extra.frame_id; }
+  // contiguous I420 planes of the frame scaled to width x height,
+  // nullptr if camerad reused the buffer while it was converted
+  const uint8_t *i420(int width, int height);
+  // contiguous NV12 planes of the frame scaled to width x height, use buf directly for the full size
+  const uint8_t *nv12(int width, int height);
+
+  VisionBuf *const buf;
+  VisionIpcBufExtra extra;
+  const uint64_t timestamp_received;  // when encoderd got the frame from visionipc
+
+private:
+  std::vector<uint8_t> alloc(size_t size) { return pool ? pool->get(size) : std::vector<uint8_t>(size); }
+
+  std::shared_ptr<EncoderBufferPool> pool;
+  std::mutex lock;
+  std::map<std::pair<int, int>, std::vector<uint8_t>> planes, nv12_planes;
+};
+
 class VideoEncoder {
 public:
   VideoEncoder(const EncoderInfo &encoder_info, int in_width, int in_height);
   virtual ~VideoEncoder() {}
-  virtual int encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) = 0;
+  virtual int encode_frame(EncoderFrame *input) = 0;
   virtual void encoder_open(const char* path) = 0;
   virtual void encoder_close() = 0;
+  // takes effect on the next encoder_open
+  void set_bitrate(int target_bitrate) { bitrate = target_bitrate; }
+  // events are passed to output instead of being published, for encoding offline
+  typedef std::function<void(MessageBuilder &msg)> OutputFunc;
+  void set_output(OutputFunc func) { output = func; }
 
   void publisher_publish(VideoEncoder *e, int segment_num, uint32_t idx, VisionIpcBufExtra &extra, unsigned int flags, kj::ArrayPtr<capnp::byte> header, kj::ArrayPtr<capnp::byte> dat);
+  // call right before encode_frame, the timestamps are published in the EncodeIndex of the frame
+  void trace_encode_start(const EncoderFrame *input);
 
 protected:
   void publish_thumbnail(uint32_t frame_id, uint64_t timestamp_eof, kj::ArrayPtr<capnp::byte> dat);
+  PubMaster *publisher();
 
   int in_width, in_height;
   int out_width, out_height;
   const EncoderInfo encoder_info;
+  int bitrate;
 
 private:
   // total frames encoded
   int cnt = 0;
   std::unique_ptr<PubMaster> pm;
+  OutputFunc output;
   std::vector<capnp::byte> msg_cache;
+
+  // frame id -> (received, encode start). hardware encoders publish from another thread
+  std::mutex trace_lock;
+  std::map<uint32_t, std::pair<uint64_t, uint64_t>> traces;
 };
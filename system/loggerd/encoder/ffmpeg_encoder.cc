@@ -11,8 +11,6 @@
 
 #define __STDC_CONSTANT_MACROS
 
-#include "third_party/libyuv/include/libyuv.h"
-
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -23,40 +21,52 @@ extern "C" {
 #include "common/util.h"
 
 const int env_debug_encoder = (getenv("DEBUG_ENCODER") != NULL) ? atoi(getenv("DEBUG_ENCODER")) : 0;
+// ffmpeg encoder to use instead of ffvhuff, for benchmarking. loggerd only remuxes the codecs it expects.
+const char *env_encoder_codec = getenv("ENCODER_CODEC");
 
-FfmpegEncoder::FfmpegEncoder(const EncoderInfo &encoder_info, int in_width, int in_height)
-    : VideoEncoder(encoder_info, in_width, in_height) {
+FfmpegEncoder::FfmpegEncoder(const EncoderInfo &encoder_info, int in_width, int in_height, const char *codec_name,
+                             bool zero_latency)
+    : VideoEncoder(encoder_info, in_width, in_height), codec_name(codec_name ? codec_name : env_encoder_codec),
+      zero_latency(zero_latency) {
   frame = av_frame_alloc();
   assert(frame);
-  frame->format = AV_PIX_FMT_YUV420P;
   frame->width = out_width;
   frame->height = out_height;
-  frame->linesize[0] = out_width;
-  frame->linesize[1] = out_width/2;
-  frame->linesize[2] = out_width/2;
-
-  convert_buf.resize(in_width * in_height * 3 / 2);
 
-  if (in_width != out_width || in_height != out_height) {
-    downscale_buf.resize(out_width * out_height * 3 / 2);
-  }
+  pkt = av_packet_alloc();
+  assert(pkt);
 }
 
 FfmpegEncoder::~FfmpegEncoder() {
   encoder_close();
   av_frame_free(&frame);
+  av_packet_free(&pkt);
 }
 
 void FfmpegEncoder::encoder_open(const char* path) {
-  const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_FFVHUFF);
+  const AVCodec *codec = codec_name ? avcodec_find_encoder_by_name(codec_name)
+                                    : avcodec_find_encoder(AV_CODEC_ID_FFVHUFF);
+  assert(codec);
+
+  // pass NV12 straight to the codec if it takes it, otherwise convert to I420
+  nv12 = false;
+  for (const AVPixelFormat *fmt = codec->pix_fmts; fmt && *fmt != AV_PIX_FMT_NONE; ++fmt) {
+    nv12 = nv12 || *fmt == AV_PIX_FMT_NV12;
+  }
+  frame->format = nv12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
 
   this->codec_ctx = avcodec_alloc_context3(codec);
   assert(this->codec_ctx);
   this->codec_ctx->width = frame->width;
   this->codec_ctx->height = frame->height;
-  this->codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  this->codec_ctx->pix_fmt = (AVPixelFormat)frame->format;
   this->codec_ctx->time_base = (AVRational){ 1, encoder_info.fps };
-  int err = avcodec_open2(this->codec_ctx, codec, NULL);
+  this->codec_ctx->bit_rate = bitrate;  // ignored by lossless codecs
+  // one packet out for every frame in, packets are published with the extra of the frame just sent
+  AVDictionary *opts = NULL;
+  if (zero_latency) av_dict_set(&opts, "tune", "zerolatency", 0);
+  int err = avcodec_open2(this->codec_ctx, codec, &opts);
+  av_dict_free(&opts);
   assert(err >= 0);
 
   is_open = true;
@@ -71,40 +81,30 @@ void FfmpegEncoder::encoder_close() {
   is_open = false;
 }
 
-int FfmpegEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
-  assert(buf->width == this->in_width);
-  assert(buf->height == this->in_height);
-
-  uint8_t *cy = convert_buf.data();
-  uint8_t *cu = cy + in_width * in_height;
-  uint8_t *cv = cu + (in_width / 2) * (in_height / 2);
-  libyuv::NV12ToI420(buf->y, buf->stride,
-                     buf->uv, buf->stride,
-                     cy, in_width,
-                     cu, in_width/2,
-                     cv, in_width/2,
-                     in_width, in_height);
-
-  if (downscale_buf.size() > 0) {
-    uint8_t *out_y = downscale_buf.data();
-    uint8_t *out_u = out_y + frame->width * frame->height;
-    uint8_t *out_v = out_u + (frame->width / 2) * (frame->height / 2);
-    libyuv::I420Scale(cy, in_width,
-                      cu, in_width/2,
-                      cv, in_width/2,
-                      in_width, in_height,
-                      out_y, frame->width,
-                      out_u, frame->width/2,
-                      out_v, frame->width/2,
-                      frame->width, frame->height,
-                      libyuv::kFilterNone);
-    frame->data[0] = out_y;
-    frame->data[1] = out_u;
-    frame->data[2] = out_v;
+int FfmpegEncoder::encode_frame(EncoderFrame *input) {
+  assert(input->buf->width == this->in_width);
+  assert(input->buf->height == this->in_height);
+
+  // conversions are shared with the other encoders of this camera
+  const int w = frame->width, h = frame->height;
+  if (nv12 && w == in_width && h == in_height) {
+    frame->data[0] = input->buf->y;
+    frame->data[1] = input->buf->uv;
+    frame->linesize[0] = frame->linesize[1] = input->buf->stride;
+  } else if (nv12) {
+    uint8_t *y = (uint8_t *)input->nv12(w, h);
+    if (!y) return -1;
+    frame->data[0] = y;
+    frame->data[1] = y + w * h;
+    frame->linesize[0] = frame->linesize[1] = w;
   } else {
-    frame->data[0] = cy;
-    frame->data[1] = cu;
-    frame->data[2] = cv;
+    uint8_t *y = (uint8_t *)input->i420(w, h);
+    if (!y) return -1;
+    frame->data[0] = y;
+    frame->data[1] = y + w * h;
+    frame->data[2] = frame->data[1] + (w / 2) * (h / 2);
+    frame->linesize[0] = w;
+    frame->linesize[1] = frame->linesize[2] = w / 2;
   }
   frame->pts = counter*50*1000; // 50ms per frame
 
@@ -116,12 +116,8 @@ int FfmpegEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
     ret = -1;
   }
 
-  AVPacket pkt;
-  av_init_packet(&pkt);
-  pkt.data = NULL;
-  pkt.size = 0;
   while (ret >= 0) {
-    err = avcodec_receive_packet(this->codec_ctx, &pkt);
+    err = avcodec_receive_packet(this->codec_ctx, pkt);
     if (err == AVERROR_EOF) {
       break;
     } else if (err == AVERROR(EAGAIN)) {
@@ -135,16 +131,16 @@ int FfmpegEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
     }
 
     if (env_debug_encoder) {
-      printf("%20s got %8d bytes flags %8x idx %4d id %8d\n", encoder_info.publish_name, pkt.size, pkt.flags, counter, extra->frame_id);
+      printf("%20s got %8d bytes flags %8x idx %4d id %8d\n", encoder_info.publish_name, pkt->size, pkt->flags, counter, input->extra.frame_id);
     }
 
-    publisher_publish(this, segment_num, counter, *extra,
-      (pkt.flags & AV_PKT_FLAG_KEY) ? V4L2_BUF_FLAG_KEYFRAME : 0,
-      kj::arrayPtr<capnp::byte>(pkt.data, (size_t)0), // TODO: get the header
-      kj::arrayPtr<capnp::byte>(pkt.data, pkt.size));
+    publisher_publish(this, segment_num, counter, input->extra,
+      (pkt->flags & AV_PKT_FLAG_KEY) ? V4L2_BUF_FLAG_KEYFRAME : 0,
+      kj::arrayPtr<capnp::byte>(pkt->data, (size_t)0), // TODO: get the header
+      kj::arrayPtr<capnp::byte>(pkt->data, pkt->size));
 
     counter++;
+    av_packet_unref(pkt);
   }
-  av_packet_unref(&pkt);
   return ret;
 }
@@ -16,9 +16,12 @@ extern "C" {
 
 class FfmpegEncoder : public VideoEncoder {
 public:
-  FfmpegEncoder(const EncoderInfo &encoder_info, int in_width, int in_height);
+  // codec_name is an ffmpeg encoder like libx264, ENCODER_CODEC or ffvhuff if not set.
+  // zero_latency tunes codecs that buffer frames to output a packet for every frame
+  FfmpegEncoder(const EncoderInfo &encoder_info, int in_width, int in_height, const char *codec_name = nullptr,
+                bool zero_latency = false);
   ~FfmpegEncoder();
-  int encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra);
+  int encode_frame(EncoderFrame *input);
   void encoder_open(const char* path);
   void encoder_close();
 
@@ -26,9 +29,11 @@ private:
   int segment_num = -1;
   int counter = 0;
   bool is_open = false;
+  const char *codec_name;
+  const bool zero_latency;
 
+  bool nv12 = false;  // the codec takes NV12, frames are passed without conversion
   AVCodecContext *codec_ctx;
   AVFrame *frame = NULL;
-  std::vector<uint8_t> convert_buf;
-  std::vector<uint8_t> downscale_buf;
+  AVPacket *pkt = NULL;
 };
@@ -215,7 +215,7 @@ V4LEncoder::V4LEncoder(const EncoderInfo &encoder_info, int in_width, int in_hei
   {
     struct v4l2_control ctrls[] = {
       { .id = V4L2_CID_MPEG_VIDEO_HEADER_MODE, .value = V4L2_MPEG_VIDEO_HEADER_MODE_SEPARATE},
-      { .id = V4L2_CID_MPEG_VIDEO_BITRATE, .value = encoder_info.bitrate},
+      { .id = V4L2_CID_MPEG_VIDEO_BITRATE, .value = bitrate},
       { .id = V4L2_CID_MPEG_VIDC_VIDEO_RATE_CONTROL, .value = V4L2_CID_MPEG_VIDC_VIDEO_RATE_CONTROL_VBR_CFR},
       { .id = V4L2_CID_MPEG_VIDC_VIDEO_PRIORITY, .value = V4L2_MPEG_VIDC_VIDEO_PRIORITY_REALTIME_DISABLE},
       { .id = V4L2_CID_MPEG_VIDC_VIDEO_IDR_PERIOD, .value = 1},
@@ -276,24 +276,30 @@ V4LEncoder::V4LEncoder(const EncoderInfo &encoder_info, int in_width, int in_hei
 }
 
 void V4LEncoder::encoder_open(const char* path) {
+  // the bitrate may change between segments
+  struct v4l2_control bitrate_ctrl = { .id = V4L2_CID_MPEG_VIDEO_BITRATE, .value = bitrate };
+  checked_ioctl(fd, VIDIOC_S_CTRL, &bitrate_ctrl);
+
   dequeue_handler_thread = std::thread(V4LEncoder::dequeue_handler, this);
   this->is_open = true;
   this->counter = 0;
 }
 
-int V4LEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
+int V4LEncoder::encode_frame(EncoderFrame *input) {
+  // the hardware encoder reads NV12 directly from the VisionBuf, nothing to convert
+  const VisionIpcBufExtra &extra = input->extra;
   struct timeval timestamp {
-    .tv_sec = (long)(extra->timestamp_eof/1000000000),
-    .tv_usec = (long)((extra->timestamp_eof/1000) % 1000000),
+    .tv_sec = (long)(extra.timestamp_eof/1000000000),
+    .tv_usec = (long)((extra.timestamp_eof/1000) % 1000000),
   };
 
   // reserve buffer
   int buffer_in = free_buf_in.pop();
 
   // push buffer
-  extras.push(*extra);
+  extras.push(extra);
   //buf->sync(VISIONBUF_SYNC_TO_DEVICE);
-  queue_buffer(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, buffer_in, buf, timestamp);
+  queue_buffer(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, buffer_in, input->buf, timestamp);
 
   return this->counter++;
 }
@@ -10,7 +10,7 @@ class V4LEncoder : public VideoEncoder {
 public:
   V4LEncoder(const EncoderInfo &encoder_info, int in_width, int in_height);
   ~V4LEncoder();
-  int encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra);
+  int encode_frame(EncoderFrame *input);
   void encoder_open(const char* path);
   void encoder_close();
 private:
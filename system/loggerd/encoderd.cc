@@ -1,5 +1,11 @@
+#include <sys/statvfs.h>
+
+#include <algorithm>
 #include <cassert>
 
+#include "common/queue.h"
+#include "common/timing.h"
+#include "system/loggerd/encoder/bitrate_controller.h"
 #include "system/loggerd/loggerd.h"
 
 #ifdef QCOM2
@@ -12,8 +18,12 @@
 
 ExitHandler do_exit;
 
+// frames queued for an encoder beyond this are dropped, camerad would reuse their buffers soon anyway
+constexpr size_t MAX_QUEUED_FRAMES = 4;
+
 struct EncoderdState {
   int max_waiting = 0;
+  std::unique_ptr<BitrateController> bitrate_controller;  // only for the logged encoders
 
   // Sync logic for startup
   std::atomic<int> encoders_ready = 0;
@@ -44,10 +54,103 @@ bool sync_encoders(EncoderdState *s, CameraType cam_type, uint32_t frame_id) {
 }
 
 
+// Runs one encoder on its own thread, so a slow encode doesn't delay the other encoders of the camera.
+class EncoderWorker {
+public:
+  EncoderWorker(const EncoderInfo &encoder_info, int width, int height, const BitrateController *bitrate_controller)
+      : info(encoder_info), name(encoder_info.publish_name), controller(bitrate_controller),
+        encoder(new Encoder(encoder_info, width, height)) {
+    updateBitrate();
+    encoder->encoder_open(nullptr);
+    thread = std::thread(&EncoderWorker::run, this);
+  }
+  ~EncoderWorker() { thread.join(); }
+
+  void push(int segment, const std::shared_ptr<EncoderFrame> &frame) {
+    if (queue.size() >= MAX_QUEUED_FRAMES) {
+      ++dropped;
+      return;
+    }
+    queue.push({segment, millis_since_boot(), frame});
+  }
+
+private:
+  struct Job {
+    int segment;
+    double queued_tms;
+    std::shared_ptr<EncoderFrame> frame;
+  };
+
+  void updateBitrate() {
+    if (!controller) return;
+
+    const int target = controller->bitrate(info);
+    if (target != bitrate) {
+      LOGW("encoder %s: bitrate %d -> %d", name, bitrate, target);
+      bitrate = target;
+      encoder->set_bitrate(bitrate);
+    }
+  }
+
+  void run() {
+    util::set_thread_name(name);
+
+    int segment = 0, encoded = 0;
+    double total_latency_ms = 0, max_latency_ms = 0;
+    Job job;
+    while (!do_exit) {
+      if (!queue.try_pop(job, 50)) continue;
+
+      // do rotation if required
+      if (job.segment != segment) {
+        LOGW("encoder %s: %d frames, dropped %d, queue latency avg %.2f ms max %.2f ms", name, encoded, dropped.exchange(0),
+             encoded ? total_latency_ms / encoded : 0., max_latency_ms);
+        encoder->encoder_close();
+        updateBitrate();
+        encoder->encoder_open(NULL);
+        segment = job.segment;
+        encoded = 0;
+        total_latency_ms = max_latency_ms = 0;
+      }
+
+      const double latency_ms = millis_since_boot() - job.queued_tms;
+      total_latency_ms += latency_ms;
+      max_latency_ms = std::max(max_latency_ms, latency_ms);
+      if (!job.frame->valid()) {
+        ++dropped;
+        continue;
+      }
+
+      // encode a frame
+      encoder->trace_encode_start(job.frame.get());
+      int out_id = encoder->encode_frame(job.frame.get());
+      if (out_id == -1 && !job.frame->valid()) {
+        // camerad reused the buffer while it was converted
+        ++dropped;
+        continue;
+      } else if (out_id == -1) {
+        LOGE("Failed to encode frame. frame_id: %d", job.frame->extra.frame_id);
+      }
+      ++encoded;
+    }
+  }
+
+  const EncoderInfo info;
+  const char *name;
+  const BitrateController *controller;
+  int bitrate = info.bitrate;
+  std::unique_ptr<Encoder> encoder;
+  SafeQueue<Job> queue;
+  std::atomic<int> dropped = 0;
+  std::thread thread;
+};
+
 void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
   util::set_thread_name(cam_info.thread_name);
 
-  std::vector<std::unique_ptr<Encoder>> encoders;
+  std::vector<std::unique_ptr<EncoderWorker>> workers;
+  // the converted planes of released frames are reused for the next ones
+  auto buffer_pool = std::make_shared<EncoderBufferPool>();
   VisionIpcClient vipc_client = VisionIpcClient("camerad", cam_info.stream_type, false);
 
   int cur_seg = 0;
@@ -58,14 +161,13 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
     }
 
     // init encoders
-    if (encoders.empty()) {
+    if (workers.empty()) {
       VisionBuf buf_info = vipc_client.buffers[0];
       LOGW("encoder %s init %zux%zu", cam_info.thread_name, buf_info.width, buf_info.height);
       assert(buf_info.width > 0 && buf_info.height > 0);
 
       for (const auto &encoder_info : cam_info.encoder_infos) {
-        auto &e = encoders.emplace_back(new Encoder(encoder_info, buf_info.width, buf_info.height));
-        e->encoder_open(nullptr);
+        workers.emplace_back(new EncoderWorker(encoder_info, buf_info.width, buf_info.height, s->bitrate_controller.get()));
       }
     }
 
@@ -74,6 +176,7 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
       VisionIpcBufExtra extra;
       VisionBuf* buf = vipc_client.recv(&extra);
       if (buf == nullptr) continue;
+      const uint64_t received = nanos_since_boot();
 
       // detect loop around and drop the frames
       if (buf->get_frame_id() != extra.frame_id) {
@@ -90,31 +193,70 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
       }
       if (do_exit) break;
 
-      // do rotation if required
+      // the workers rotate when they see the next segment
       const int frames_per_seg = SEGMENT_LENGTH * MAIN_FPS;
       if (cur_seg >= 0 && extra.frame_id >= ((cur_seg + 1) * frames_per_seg) + s->start_frame_id) {
-        for (auto &e : encoders) {
-          e->encoder_close();
-          e->encoder_open(NULL);
-        }
         ++cur_seg;
       }
 
-      // encode a frame
-      for (int i = 0; i < encoders.size(); ++i) {
-        int out_id = encoders[i]->encode_frame(buf, &extra);
+      auto frame = std::make_shared<EncoderFrame>(buf, extra, received, buffer_pool);
+      for (auto &w : workers) {
+        w->push(cur_seg, frame);
+      }
+    }
+  }
+}
 
-        if (out_id == -1) {
-          LOGE("Failed to encode frame. frame_id: %d", extra.frame_id);
-        }
+// Feeds the bitrate controller once per segment with the free space, the encoders' output rate and loggerd's slow writes.
+void bitrate_controller_thread(BitrateController *controller) {
+  util::set_thread_name("encoderd_bitrate");
+  SubMaster sm({"loggerStats"});
+
+  uint64_t prev_bytes = 0, prev_slow_writes = 0;
+  double prev_tms = 0;
+  while (!do_exit) {
+    sm.update(1000);
+    if (!sm.updated("loggerStats")) continue;
+
+    uint64_t bytes = 0, slow_writes = 0;
+    for (auto stats : sm["loggerStats"].getLoggerStats().getServices()) {
+      if (util::ends_with(stats.getName().cStr(), "EncodeData")) bytes += stats.getBytes();
+    }
+    auto write_stalls = sm["loggerStats"].getLoggerStats().getWriteStalls();
+    for (uint32_t i = BitrateController::SLOW_WRITE_BUCKET; i < write_stalls.size(); ++i) {
+      slow_writes += write_stalls[i];
+    }
+
+    const double tms = millis_since_boot();
+    if (prev_tms == 0 || bytes < prev_bytes) {
+      // first stats or loggerd restarted
+      prev_tms = tms;
+      prev_bytes = bytes;
+      prev_slow_writes = slow_writes;
+    } else if (tms - prev_tms >= SEGMENT_LENGTH * 1000) {
+      struct statvfs buf;
+      if (statvfs(Path::log_root().c_str(), &buf) == 0) {
+        controller->update({
+          .free_bytes = (uint64_t)buf.f_bavail * buf.f_frsize,
+          .output_rate = (bytes - prev_bytes) / ((tms - prev_tms) / 1000.),
+          .slow_writes = slow_writes - prev_slow_writes,
+        });
       }
+      prev_tms = tms;
+      prev_bytes = bytes;
+      prev_slow_writes = slow_writes;
     }
   }
 }
 
 template <size_t N>
-void encoderd_thread(const LogCameraInfo (&cameras)[N]) {
+void encoderd_thread(const LogCameraInfo (&cameras)[N], bool adaptive_bitrate) {
   EncoderdState s;
+  std::thread controller_thread;
+  if (adaptive_bitrate) {
+    s.bitrate_controller = std::make_unique<BitrateController>();
+    controller_thread = std::thread(bitrate_controller_thread, s.bitrate_controller.get());
+  }
 
   std::set<VisionStreamType> streams;
   while (!do_exit) {
@@ -137,6 +279,7 @@ void encoderd_thread(const LogCameraInfo (&cameras)[N]) {
 
     for (auto &t : encoder_threads) t.join();
   }
+  if (controller_thread.joinable()) controller_thread.join();
 }
 
 int main(int argc, char* argv[]) {
@@ -150,12 +293,12 @@ int main(int argc, char* argv[]) {
   if (argc > 1) {
     std::string arg1(argv[1]);
     if (arg1 == "--stream") {
-      encoderd_thread(stream_cameras_logged);
+      encoderd_thread(stream_cameras_logged, false);
     } else {
       LOGE("Argument '%s' is not supported", arg1.c_str());
     }
   } else {
-    encoderd_thread(cameras_logged);
+    encoderd_thread(cameras_logged, true);
   }
   return 0;
 }
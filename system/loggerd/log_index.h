@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A sidecar index next to each rlog/qlog listing where the events of every service are, so readers that need only a
+// few services can read just those byte ranges. Offsets are in the uncompressed log.
+//   [Header][for each service: Service, num_blocks * Block]
+// Each block covers events of one service that are close together in the file, a block is read as a whole.
+namespace log_index {
+
+constexpr uint32_t MAGIC = 0x58444C4F;  // "OLDX"
+constexpr uint32_t VERSION = 1;
+constexpr uint64_t MAX_BLOCK_GAP = 64 * 1024;    // start a new block if the next event is further than this
+constexpr uint64_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_services;
+  uint32_t reserved;
+};
+
+struct Service {
+  uint16_t which;  // cereal::Event::Which
+  uint16_t reserved;
+  uint32_t num_blocks;
+};
+
+struct Block {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t count;
+  uint64_t start_mono_time;
+  uint64_t end_mono_time;
+};
+
+typedef std::map<uint16_t, std::vector<Block>> Index;
+
+class Builder {
+public:
+  void add(uint16_t which, uint64_t mono_time, uint64_t offset, uint32_t size) {
+    auto &blocks = index[which];
+    if (blocks.empty() || offset - (blocks.back().offset + blocks.back().size) > MAX_BLOCK_GAP ||
+        offset + size - blocks.back().offset > MAX_BLOCK_SIZE) {
+      blocks.push_back({offset, 0, 0, mono_time, mono_time});
+    }
+    auto &b = blocks.back();
+    b.size = offset + size - b.offset;
+    b.count += 1;
+    b.start_mono_time = std::min(b.start_mono_time, mono_time);
+    b.end_mono_time = std::max(b.end_mono_time, mono_time);
+  }
+
+  std::string serialize() const {
+    Header header = {MAGIC, VERSION, (uint32_t)index.size(), 0};
+    std::string out((const char *)&header, sizeof(header));
+    for (const auto &[which, blocks] : index) {
+      Service service = {which, 0, (uint32_t)blocks.size()};
+      out.append((const char *)&service, sizeof(service));
+      out.append((const char *)blocks.data(), blocks.size() * sizeof(Block));
+    }
+    return out;
+  }
+
+  void clear() { index.clear(); }
+
+private:
+  Index index;
+};
+
+// Returns an empty index if the data is not a valid index.
+inline Index read(const std::string &data) {
+  Index index;
+  Header header;
+  if (data.size() < sizeof(header)) return index;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != MAGIC || header.version != VERSION) return index;
+
+  size_t pos = sizeof(header);
+  for (uint32_t i = 0; i < header.num_services; ++i) {
+    Service service;
+    if (pos + sizeof(service) > data.size()) return {};
+    memcpy(&service, data.data() + pos, sizeof(service));
+    pos += sizeof(service);
+
+    if (pos + (size_t)service.num_blocks * sizeof(Block) > data.size()) return {};
+    auto &blocks = index[service.which];
+    blocks.resize(service.num_blocks);
+    memcpy(blocks.data(), data.data() + pos, service.num_blocks * sizeof(Block));
+    pos += service.num_blocks * sizeof(Block);
+  }
+  return index;
+}
+
+// Returns the sorted, merged byte ranges (offset, size) holding all events of the services for which filter(which) is true.
+// Ranges always start and end at event boundaries.
+template <typename Filter>
+std::vector<std::pair<uint64_t, uint64_t>> ranges(const Index &index, Filter filter) {
+  std::vector<std::pair<uint64_t, uint64_t>> blocks;
+  for (const auto &[which, service_blocks] : index) {
+    if (!filter(which)) continue;
+    for (const auto &b : service_blocks) blocks.push_back({b.offset, b.offset + b.size});
+  }
+  std::sort(blocks.begin(), blocks.end());
+
+  std::vector<std::pair<uint64_t, uint64_t>> merged;
+  for (const auto &[begin, end] : blocks) {
+    if (!merged.empty() && begin <= merged.back().first + merged.back().second) {
+      merged.back().second = std::max(merged.back().second, end - merged.back().first);
+    } else {
+      merged.push_back({begin, end - begin});
+    }
+  }
+  return merged;
+}
+
+}  // namespace log_index
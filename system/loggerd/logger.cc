@@ -1,5 +1,10 @@
 #include "system/loggerd/logger.h"
 
+#include <fcntl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <vector>
@@ -9,6 +14,7 @@
 
 #include "common/params.h"
 #include "common/swaglog.h"
+#include "common/timing.h"
 #include "common/version.h"
 
 // ***** log metadata *****
@@ -121,7 +127,168 @@ static void log_sentinel(LoggerState *log, SentinelType type, int exit_signal =
   log->write(msg.toBytes(), true);
 }
 
-LoggerState::LoggerState(const std::string &log_root) {
+// ***** AsyncFileWriter *****
+
+AsyncFileWriter::AsyncFileWriter(FILE *f, size_t size, size_t count) : file(f), buffer_size(size), max_buffers(std::max<size_t>(count, 2)) {
+  thread = std::thread(&AsyncFileWriter::writeThread, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  {
+    std::lock_guard lk(lock);
+    submit();
+    exit_writer = true;
+  }
+  cv.notify_all();
+  thread.join();
+}
+
+void AsyncFileWriter::write(const void *data, size_t size) {
+  const char *src = (const char *)data;
+  // the writer thread may take a buffer that is not full
+  std::unique_lock lk(lock);
+  while (size > 0) {
+    if (!current.data) acquire(lk);
+    if (current.size == 0) {
+      current_start_ms = millis_since_boot();
+      cv.notify_all();
+    }
+    size_t n = std::min(size, buffer_size - current.size);
+    memcpy(current.data.get() + current.size, src, n);
+    current.size += n;
+    src += n;
+    size -= n;
+    if (current.size == buffer_size) submit();
+  }
+}
+
+// Queues the current buffer for writing, with the lock held.
+void AsyncFileWriter::submit() {
+  if (current.size == 0) return;
+
+  pending.push_back(std::move(current));
+  current = {};
+  stats_.queue_depth = pending.size();
+  stats_.max_queue_depth = std::max(stats_.max_queue_depth, pending.size());
+  cv.notify_all();
+}
+
+// Takes a free buffer, waiting only if all buffers are in use.
+void AsyncFileWriter::acquire(std::unique_lock<std::mutex> &lk) {
+  if (free_buffers.empty() && allocated < max_buffers) {
+    current.data.reset((char *)aligned_alloc(4096, (buffer_size + 4095) / 4096 * 4096));
+    assert(current.data);
+    ++allocated;
+  } else {
+    if (free_buffers.empty()) {
+      double start_ms = millis_since_boot();
+      cv.wait(lk, [this]() { return !free_buffers.empty(); });
+      ++stats_.stalls;
+      stats_.stall_ms += millis_since_boot() - start_ms;
+    }
+    current = std::move(free_buffers.front());
+    free_buffers.pop_front();
+  }
+  current.size = 0;
+}
+
+void AsyncFileWriter::writeThread() {
+  util::set_thread_name("loggerd_writer");
+  std::unique_lock lk(lock);
+  while (true) {
+    if (pending.empty() && !exit_writer) {
+      // wake up when the current buffer gets too old, the caller may not write again for a while
+      const double wait_ms = current.size > 0 ? current_start_ms + MAX_BUFFER_AGE_MS - millis_since_boot() : MAX_BUFFER_AGE_MS;
+      cv.wait_for(lk, std::chrono::duration<double, std::milli>(std::max(wait_ms, 1.0)));
+    }
+    // don't keep data in memory for long when the file is written slowly
+    if (pending.empty() && current.size > 0 && millis_since_boot() - current_start_ms >= MAX_BUFFER_AGE_MS) {
+      submit();
+    }
+    if (pending.empty()) {
+      if (exit_writer) break;
+      continue;
+    }
+
+    Buffer buf = std::move(pending.front());
+    pending.pop_front();
+    lk.unlock();
+
+    double start_ms = millis_since_boot();
+    size_t written = util::safe_fwrite(buf.data.get(), 1, buf.size, file);
+    assert(written == buf.size);
+    double write_ms = millis_since_boot() - start_ms;
+
+    lk.lock();
+    stats_.queue_depth = pending.size();
+    stats_.max_write_ms = std::max(stats_.max_write_ms, write_ms);
+    stats_.bytes_written += written;
+    free_buffers.push_back(std::move(buf));
+    cv.notify_all();
+  }
+}
+
+AsyncFileWriter::Stats AsyncFileWriter::stats() {
+  std::lock_guard lk(lock);
+  return stats_;
+}
+
+// ***** ZstdFile *****
+
+ZstdFile::ZstdFile(const std::string &path, bool async, int level, size_t events_per_frame, size_t bytes_per_frame)
+    : RawFile(path, async), max_events(events_per_frame), max_bytes(bytes_per_frame) {
+  cctx = ZSTD_createCCtx();
+  assert(cctx != nullptr);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+  frame.reserve(max_bytes + 64 * 1024);
+  compressed.resize(ZSTD_compressBound(max_bytes + 64 * 1024));
+}
+
+ZstdFile::~ZstdFile() {
+  flushFrame();
+
+  const uint32_t index_size = index.size() * sizeof(zstd_index::Entry) + sizeof(zstd_index::Footer);
+  const uint32_t header[] = {zstd_index::SKIPPABLE_MAGIC, index_size};
+  const zstd_index::Footer footer = {.num_frames = (uint32_t)index.size(), .magic = zstd_index::FOOTER_MAGIC};
+  RawFile::write((void *)header, sizeof(header));
+  RawFile::write(index.data(), index.size() * sizeof(zstd_index::Entry));
+  RawFile::write((void *)&footer, sizeof(footer));
+  ZSTD_freeCCtx(cctx);
+}
+
+void ZstdFile::write(void* data, size_t size) {
+  if (num_events == 0) {
+    frame_start_ms = millis_since_boot();
+    // the first event of each frame is parsed for the time index
+    try {
+      capnp::FlatArrayMessageReader reader(kj::ArrayPtr<const capnp::word>((const capnp::word *)data, size / sizeof(capnp::word)));
+      first_mono_time = reader.getRoot<cereal::Event>().getLogMonoTime();
+    } catch (const kj::Exception &) {
+      first_mono_time = index.empty() ? 0 : index.back().first_mono_time;
+    }
+  }
+  frame.append((const char *)data, size);
+  if (++num_events >= max_events || frame.size() >= max_bytes || millis_since_boot() - frame_start_ms >= FRAME_MAX_AGE_MS) {
+    flushFrame();
+  }
+}
+
+void ZstdFile::flushFrame() {
+  if (frame.empty()) return;
+
+  compressed.resize(std::max(compressed.size(), ZSTD_compressBound(frame.size())));
+  size_t compressed_size = ZSTD_compress2(cctx, compressed.data(), compressed.size(), frame.data(), frame.size());
+  assert(!ZSTD_isError(compressed_size));
+  RawFile::write(compressed.data(), compressed_size);
+  index.push_back({(uint32_t)compressed_size, (uint32_t)frame.size(), first_mono_time});
+  frame.clear();
+  num_events = 0;
+}
+
+// ***** LoggerState *****
+
+LoggerState::LoggerState(const std::string &log_root, bool zstd) : compress(zstd) {
   route_name = logger_get_identifier("RouteCount");
   route_path = log_root + "/" + route_name;
   init_data = logger_build_init_data();
@@ -130,13 +297,28 @@ LoggerState::LoggerState(const std::string &log_root) {
 LoggerState::~LoggerState() {
   if (rlog) {
     log_sentinel(this, SentinelType::END_OF_ROUTE, exit_signal);
+    writeIndex();
     std::remove(lock_file.c_str());
   }
 }
 
+void LoggerState::writeIndex() {
+  // compressed logs are indexed by their zstd frames
+  if (compress) return;
+
+  for (auto [name, index] : {std::pair{"/rlog.idx", &rlog_index}, std::pair{"/qlog.idx", &qlog_index}}) {
+    const std::string data = index->serialize();
+    int ret = util::write_file((segment_path + name).c_str(), data.data(), data.size(), O_WRONLY | O_CREAT | O_TRUNC);
+    if (ret != 0) LOGE("failed to write %s%s", segment_path.c_str(), name);
+    index->clear();
+  }
+  rlog_offset = qlog_offset = 0;
+}
+
 bool LoggerState::next() {
   if (rlog) {
     log_sentinel(this, SentinelType::END_OF_SEGMENT);
+    writeIndex();
     std::remove(lock_file.c_str());
   }
 
@@ -148,8 +330,24 @@ bool LoggerState::next() {
   lock_file = rlog_path + ".lock";
   std::ofstream{lock_file};
 
-  rlog.reset(new RawFile(rlog_path));
-  qlog.reset(new RawFile(segment_path + "/qlog"));
+  if (rlog) {
+    for (auto [name, file] : {std::pair{"rlog", rlog.get()}, std::pair{"qlog", qlog.get()}}) {
+      auto stats = file->stats();
+      if (stats.stalls > 0) {
+        LOGW("%s writer stalled %zu times for %.1f ms, max queue depth %zu, slowest write %.1f ms",
+             name, stats.stalls, stats.stall_ms, stats.max_queue_depth, stats.max_write_ms);
+      }
+    }
+  }
+
+  // write from a separate thread so a slow storage never blocks draining the sockets
+  if (compress) {
+    rlog.reset(new ZstdFile(rlog_path + ".zst", true));
+    qlog.reset(new ZstdFile(segment_path + "/qlog.zst", true));
+  } else {
+    rlog.reset(new RawFile(rlog_path, true));
+    qlog.reset(new RawFile(segment_path + "/qlog", true));
+  }
 
   // log init data & sentinel type.
   write(init_data.asBytes(), true);
@@ -160,4 +358,16 @@ bool LoggerState::next() {
 void LoggerState::write(uint8_t* data, size_t size, bool in_qlog) {
   rlog->write(data, size);
   if (in_qlog) qlog->write(data, size);
+  if (compress) return;
+
+  try {
+    capnp::FlatArrayMessageReader reader(kj::ArrayPtr<const capnp::word>((const capnp::word *)data, size / sizeof(capnp::word)));
+    auto event = reader.getRoot<cereal::Event>();
+    rlog_index.add(event.which(), event.getLogMonoTime(), rlog_offset, size);
+    if (in_qlog) qlog_index.add(event.which(), event.getLogMonoTime(), qlog_offset, size);
+  } catch (const kj::Exception &) {
+    // not indexed, readers of the index will skip it
+  }
+  rlog_offset += size;
+  if (in_qlog) qlog_offset += size;
 }
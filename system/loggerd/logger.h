@@ -1,32 +1,124 @@
 #pragma once
 
 #include <cassert>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <zstd.h>
 
 #include "cereal/messaging/messaging.h"
 #include "common/util.h"
 #include "system/hardware/hw.h"
 
+#include "system/loggerd/log_index.h"
+#include "system/loggerd/zstd_index.h"
+
+// Writes to a file from a dedicated thread. Data is copied into large aligned buffers, which are written when full,
+// or by the writer thread once their first byte is MAX_BUFFER_AGE_MS old. Buffers are allocated on demand up to
+// max_buffers, the caller only waits for storage when all of them are queued.
+class AsyncFileWriter {
+ public:
+  struct Stats {
+    size_t queue_depth = 0;      // buffers waiting to be written
+    size_t max_queue_depth = 0;
+    size_t stalls = 0;           // number of times the caller waited for a free buffer
+    double stall_ms = 0;         // total time the caller waited
+    double max_write_ms = 0;     // slowest write of a buffer to storage
+    uint64_t bytes_written = 0;
+  };
+
+  AsyncFileWriter(FILE *file, size_t buffer_size = BUFFER_SIZE, size_t max_buffers = MAX_BUFFERS);
+  ~AsyncFileWriter();
+  void write(const void *data, size_t size);
+  Stats stats();
+
+  static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+  static constexpr size_t MAX_BUFFERS = 16;
+  static constexpr double MAX_BUFFER_AGE_MS = 1000;
+
+ private:
+  struct Buffer {
+    std::unique_ptr<char, decltype(&free)> data = {nullptr, &free};
+    size_t size = 0;
+  };
+  void submit();
+  void acquire(std::unique_lock<std::mutex> &lk);
+  void writeThread();
+
+  FILE *file;
+  const size_t buffer_size, max_buffers;
+  size_t allocated = 0;
+
+  std::mutex lock;
+  Buffer current;
+  double current_start_ms = 0;  // time of the first write into current
+  std::condition_variable cv;
+  std::deque<Buffer> pending, free_buffers;
+  bool exit_writer = false;
+  Stats stats_;
+  std::thread thread;
+};
+
 class RawFile {
  public:
-  RawFile(const std::string &path) {
+  RawFile(const std::string &path, bool async = false) {
     file = util::safe_fopen(path.c_str(), "wb");
     assert(file != nullptr);
+    if (async) writer = std::make_unique<AsyncFileWriter>(file);
   }
-  ~RawFile() {
+  virtual ~RawFile() {
+    writer.reset();
     util::safe_fflush(file);
     int err = fclose(file);
     assert(err == 0);
   }
-  inline void write(void* data, size_t size) {
-    int written = util::safe_fwrite(data, 1, size, file);
-    assert(written == size);
+  virtual void write(void* data, size_t size) {
+    if (writer) {
+      writer->write(data, size);
+    } else {
+      int written = util::safe_fwrite(data, 1, size, file);
+      assert(written == size);
+    }
   }
   inline void write(kj::ArrayPtr<capnp::byte> array) { write(array.begin(), array.size()); }
+  inline AsyncFileWriter::Stats stats() { return writer ? writer->stats() : AsyncFileWriter::Stats{}; }
 
  private:
   FILE* file = nullptr;
+  std::unique_ptr<AsyncFileWriter> writer;
+};
+
+// Compresses events into independent zstd frames of at most max_events events or max_bytes bytes, or of the
+// events of FRAME_MAX_AGE_MS, and appends the frame index when closed. See zstd_index.h for the layout.
+class ZstdFile : public RawFile {
+ public:
+  ZstdFile(const std::string &path, bool async = false, int level = ZSTD_LEVEL,
+           size_t events_per_frame = FRAME_MAX_EVENTS, size_t bytes_per_frame = FRAME_MAX_BYTES);
+  ~ZstdFile();
+  void write(void* data, size_t size) override;
+  using RawFile::write;
+
+  static constexpr int ZSTD_LEVEL = 3;
+  static constexpr size_t FRAME_MAX_EVENTS = 10000;
+  static constexpr size_t FRAME_MAX_BYTES = 1024 * 1024;
+  // frames are complete on storage within about a second, a crash only loses the last one
+  static constexpr double FRAME_MAX_AGE_MS = AsyncFileWriter::MAX_BUFFER_AGE_MS;
+
+ private:
+  void flushFrame();
+
+  ZSTD_CCtx *cctx;
+  const size_t max_events, max_bytes;
+  size_t num_events = 0;
+  uint64_t first_mono_time = 0;
+  double frame_start_ms = 0;
+  std::string frame, compressed;
+  std::vector<zstd_index::Entry> index;
 };
 
 typedef cereal::Sentinel::SentinelType SentinelType;
@@ -34,7 +126,7 @@ typedef cereal::Sentinel::SentinelType SentinelType;
 
 class LoggerState {
 public:
-  LoggerState(const std::string& log_root = Path::log_root());
+  LoggerState(const std::string& log_root = Path::log_root(), bool zstd = getenv("LOGGERD_ZSTD") != nullptr);
   ~LoggerState();
   bool next();
   void write(uint8_t* data, size_t size, bool in_qlog);
@@ -45,10 +137,15 @@ public:
   inline void setExitSignal(int signal) { exit_signal = signal; }
 
 protected:
+  void writeIndex();
+
   int part = -1, exit_signal = 0;
+  bool compress = false;
   std::string route_path, route_name, segment_path, lock_file;
   kj::Array<capnp::word> init_data;
   std::unique_ptr<RawFile> rlog, qlog;
+  log_index::Builder rlog_index, qlog_index;
+  uint64_t rlog_offset = 0, qlog_offset = 0;
 };
 
 kj::Array<capnp::word> logger_build_init_data();
@@ -1,5 +1,8 @@
 #include <sys/xattr.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <map>
 #include <memory>
 #include <string>
@@ -53,6 +56,8 @@ void rotate_if_needed(LoggerdState *s) {
   }
 }
 
+constexpr size_t IDX_SEGMENT_WORDS = 128;  // an event holding only an EncodeIndex fits in one small segment
+
 struct RemoteEncoder {
   std::unique_ptr<VideoWriter> writer;
   int encoderd_segment_offset;
@@ -62,6 +67,13 @@ struct RemoteEncoder {
   bool recording = false;
   bool marked_ready_to_rotate = false;
   bool seen_first_packet = false;
+  uint32_t last_encode_id = 0;
+  uint64_t written = 0;
+  uint64_t lost = 0;  // gaps in encodeId
+
+  // reused for every idx packet written to the log
+  std::vector<capnp::word> idx_segment = std::vector<capnp::word>(IDX_SEGMENT_WORDS);  // zeroed
+  std::vector<uint8_t> idx_buf;
 };
 
 int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct RemoteEncoder &re, const EncoderInfo &encoder_info) {
@@ -74,6 +86,15 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
   auto idx = edata.getIdx();
   auto flags = idx.getFlags();
 
+  // queued packets come through here again after the rotate, they were already counted
+  const uint32_t encode_id = idx.getEncodeId();
+  if (encode_id > re.last_encode_id) {
+    if (re.last_encode_id != 0) re.lost += encode_id - re.last_encode_id - 1;
+    re.last_encode_id = encode_id;
+  } else if (re.q.empty()) {
+    re.last_encode_id = encode_id;  // encoderd restarted
+  }
+
   // encoderd can have started long before loggerd
   if (!re.seen_first_packet) {
     re.seen_first_packet = true;
@@ -134,23 +155,34 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
     // we have to be recording if we are here
     assert(re.recording);
 
-    // if we are actually writing the video file, do so
+    // put it in log stream as the idx packet, built and serialized in the encoder's reusable buffers
+    {
+      MessageBuilder bmsg(kj::arrayPtr(re.idx_segment.data(), re.idx_segment.size()));
+      auto evt = bmsg.initEvent(event.getValid());
+      evt.setLogMonoTime(event.getLogMonoTime());
+      (evt.*(encoder_info.set_encode_idx_func))(idx);
+      (evt.*(encoder_info.get_encode_idx_func))().setTimestampLogged(nanos_since_boot());
+
+      const size_t size = capnp::computeSerializedSizeInWords(bmsg) * sizeof(capnp::word);
+      if (re.idx_buf.size() < size) {
+        re.idx_buf.resize(size);
+      }
+      kj::ArrayOutputStream stream(kj::arrayPtr(re.idx_buf.data(), size));
+      capnp::writeMessage(stream, bmsg);
+      s->logger.write(re.idx_buf.data(), size, true);   // always in qlog?
+      bytes_count += size;
+      ++re.written;
+    }
+
+    // if we are actually writing the video file, do so. the payload points into the received message,
+    // nothing is copied and the writer frees the message once the packet is written
     if (re.writer) {
       auto data = edata.getData();
-      re.writer->write((uint8_t *)data.begin(), data.size(), idx.getTimestampEof()/1000, false, flags & V4L2_BUF_FLAG_KEYFRAME);
+      re.writer->write(std::unique_ptr<Message>(msg), data.begin(), data.size(), idx.getTimestampEof()/1000, flags & V4L2_BUF_FLAG_KEYFRAME);
+    } else {
+      // free the message, we used it
+      delete msg;
     }
-
-    // put it in log stream as the idx packet
-    MessageBuilder bmsg;
-    auto evt = bmsg.initEvent(event.getValid());
-    evt.setLogMonoTime(event.getLogMonoTime());
-    (evt.*(encoder_info.set_encode_idx_func))(idx);
-    auto new_msg = bmsg.toBytes();
-    s->logger.write((uint8_t *)new_msg.begin(), new_msg.size(), true);   // always in qlog?
-    bytes_count += new_msg.size();
-
-    // free the message, we used it
-    delete msg;
   } else if (offset_segment_num > s->logger.segment()) {
     // encoderd packet has a newer segment, this means encoderd has rolled over
     if (!re.marked_ready_to_rotate) {
@@ -174,6 +206,19 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
   return bytes_count;
 }
 
+struct ServiceState {
+  std::string name;
+  int counter, freq;
+  bool encoder, user_flag, priority;
+  int max_msgs;  // per turn of the drain loop, unlimited for priority services
+
+  // stats since start
+  uint64_t received = 0;
+  uint64_t written = 0;  // for encoders, see RemoteEncoder::written
+  uint64_t bytes = 0;
+  uint64_t deferred = 0;
+};
+
 void handle_user_flag(LoggerdState *s) {
   static int prev_segment = -1;
   if (s->logger.segment() == prev_segment) return;
@@ -197,18 +242,43 @@ void handle_user_flag(LoggerdState *s) {
   prev_segment = s->logger.segment();
 }
 
+typedef std::array<uint64_t, WRITE_STALL_BUCKETS> WriteStalls;
+
+void publish_stats(PubMaster &pm, const std::unordered_map<SubSocket*, ServiceState> &service_state,
+                   std::unordered_map<SubSocket*, struct RemoteEncoder> &remote_encoders, const WriteStalls &write_stalls) {
+  MessageBuilder msg;
+  auto logger_stats = msg.initEvent().initLoggerStats();
+  auto stalls = logger_stats.initWriteStalls(write_stalls.size());
+  for (size_t i = 0; i < write_stalls.size(); ++i) {
+    stalls.set(i, write_stalls[i]);
+  }
+  auto services_stats = logger_stats.initServices(service_state.size());
+  int i = 0;
+  for (const auto &[sock, service] : service_state) {
+    auto stats = services_stats[i++];
+    stats.setName(service.name);
+    stats.setReceived(service.received);
+    stats.setBytes(service.bytes);
+    stats.setDeferred(service.deferred);
+    if (service.encoder) {
+      const auto &re = remote_encoders[sock];
+      stats.setWritten(re.written);
+      stats.setLost(re.lost);
+    } else {
+      stats.setWritten(service.written);
+    }
+  }
+  pm.send("loggerStats", msg);
+}
+
 void loggerd_thread() {
   // setup messaging
-  typedef struct ServiceState {
-    std::string name;
-    int counter, freq;
-    bool encoder, user_flag;
-  } ServiceState;
   std::unordered_map<SubSocket*, ServiceState> service_state;
   std::unordered_map<SubSocket*, struct RemoteEncoder> remote_encoders;
 
   std::unique_ptr<Context> ctx(Context::create());
   std::unique_ptr<Poller> poller(Poller::create());
+  PubMaster pm({"loggerStats"});
 
   // subscribe to all socks
   for (const auto& [_, it] : services) {
@@ -226,6 +296,8 @@ void loggerd_thread() {
       .freq = it.decimation,
       .encoder = encoder,
       .user_flag = it.name == "userFlag",
+      .priority = encoder || PRIORITY_SERVICES.count(it.name) > 0,
+      .max_msgs = std::max(MIN_MSGS_PER_TURN, (int)(it.frequency * MSGS_PER_TURN_SECONDS)),
     };
   }
 
@@ -244,9 +316,14 @@ void loggerd_thread() {
 
   uint64_t msg_count = 0, bytes_count = 0;
   double start_ts = millis_since_boot();
+  double last_stats_tms = start_ts;
+  WriteStalls write_stalls = {};
   while (!do_exit) {
-    // poll for new messages on all sockets
-    for (auto sock : poller->poll(1000)) {
+    // poll for new messages on all sockets. the poll is level-triggered, sockets that still have
+    // messages after their budget is used up are returned again on the next turn.
+    auto ready = poller->poll(1000);
+    std::stable_partition(ready.begin(), ready.end(), [&](SubSocket *sock) { return service_state[sock].priority; });
+    for (auto sock : ready) {
       if (do_exit) break;
 
       ServiceState &service = service_state[sock];
@@ -256,17 +333,27 @@ void loggerd_thread() {
 
       // drain socket
       int count = 0;
+      size_t bytes = 0;
       Message *msg = nullptr;
       while (!do_exit && (msg = sock->receive(true))) {
         const bool in_qlog = service.freq != -1 && (service.counter++ % service.freq == 0);
+        const size_t size = msg->getSize();
+        const double write_start_tms = millis_since_boot();
         if (service.encoder) {
-          s.last_camera_seen_tms = millis_since_boot();
+          s.last_camera_seen_tms = write_start_tms;
           bytes_count += handle_encoder_msg(&s, msg, service.name, remote_encoders[sock], encoder_infos_dict[service.name]);
         } else {
-          s.logger.write((uint8_t *)msg->getData(), msg->getSize(), in_qlog);
-          bytes_count += msg->getSize();
+          s.logger.write((uint8_t *)msg->getData(), size, in_qlog);
+          ++service.written;
+          bytes_count += size;
           delete msg;
         }
+        const double write_ms = millis_since_boot() - write_start_tms;
+        if (write_ms >= 1) {
+          ++write_stalls[std::min<int>(std::log2(write_ms), WRITE_STALL_BUCKETS - 1)];
+        }
+        ++service.received;
+        service.bytes += size;
 
         rotate_if_needed(&s);
 
@@ -275,13 +362,18 @@ void loggerd_thread() {
           LOGD("%" PRIu64 " messages, %.2f msg/sec, %.2f KB/sec", msg_count, msg_count / seconds, bytes_count * 0.001 / seconds);
         }
 
-        count++;
-        if (count >= 200) {
-          LOGD("large volume of '%s' messages", service.name.c_str());
+        bytes += size;
+        if (!service.priority && (++count >= service.max_msgs || bytes >= MAX_BYTES_PER_TURN)) {
+          ++service.deferred;
           break;
         }
       }
     }
+
+    if (millis_since_boot() - last_stats_tms > STATS_INTERVAL_MS) {
+      last_stats_tms = millis_since_boot();
+      publish_stats(pm, service_state, remote_encoders, write_stalls);
+    }
   }
 
   LOGW("closing logger");
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <set>
+#include <string>
 #include <vector>
 
 #include "cereal/messaging/messaging.h"
@@ -20,9 +22,19 @@ const int QCAM_BITRATE = 256000;
 
 #define NO_CAMERA_PATIENCE 500  // fall back to time-based rotation if all cameras are dead
 
+// drain loop scheduling. encoders and control services are drained completely on every turn,
+// the others get a budget proportional to their rate so a burst from one bulk service can't starve the rest.
+const std::set<std::string> PRIORITY_SERVICES = {"carState", "carControl", "carOutput", "controlsState", "sendcan", "userFlag"};
+constexpr int MIN_MSGS_PER_TURN = 10;
+constexpr double MSGS_PER_TURN_SECONDS = 0.1;  // a budget of 100ms worth of messages at the service rate
+constexpr size_t MAX_BYTES_PER_TURN = 512 * 1024;
+constexpr int STATS_INTERVAL_MS = 5000;
+constexpr int WRITE_STALL_BUCKETS = 12;
+
 #define INIT_ENCODE_FUNCTIONS(encode_type)                                \
   .get_encode_data_func = &cereal::Event::Reader::get##encode_type##Data, \
   .set_encode_idx_func = &cereal::Event::Builder::set##encode_type##Idx,  \
+  .get_encode_idx_func = &cereal::Event::Builder::get##encode_type##Idx,  \
   .init_encode_data_func = &cereal::Event::Builder::init##encode_type##Data
 
 const bool LOGGERD_TEST = getenv("LOGGERD_TEST");
@@ -40,10 +52,12 @@ public:
   int frame_height = -1;
   int fps = MAIN_FPS;
   int bitrate = MAIN_BITRATE;
+  int min_bitrate = MAIN_BITRATE / 4;  // lowest bitrate the adaptive bitrate controller may pick
   cereal::EncodeIndex::Type encode_type = Hardware::PC() ? cereal::EncodeIndex::Type::BIG_BOX_LOSSLESS
                                                          : cereal::EncodeIndex::Type::FULL_H_E_V_C;
   ::cereal::EncodeData::Reader (cereal::Event::Reader::*get_encode_data_func)() const;
   void (cereal::Event::Builder::*set_encode_idx_func)(::cereal::EncodeIndex::Reader);
+  cereal::EncodeIndex::Builder (cereal::Event::Builder::*get_encode_idx_func)();
   cereal::EncodeData::Builder (cereal::Event::Builder::*init_encode_data_func)();
 };
 
@@ -81,6 +95,7 @@ const EncoderInfo stream_road_encoder_info = {
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
   .bitrate = LIVESTREAM_BITRATE,
+  .min_bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamRoadEncode),
 };
 
@@ -89,6 +104,7 @@ const EncoderInfo stream_wide_road_encoder_info = {
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
   .bitrate = LIVESTREAM_BITRATE,
+  .min_bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamWideRoadEncode),
 };
 
@@ -97,6 +113,7 @@ const EncoderInfo stream_driver_encoder_info = {
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
   .bitrate = LIVESTREAM_BITRATE,
+  .min_bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamDriverEncode),
 };
 
@@ -104,6 +121,7 @@ const EncoderInfo qcam_encoder_info = {
   .publish_name = "qRoadEncodeData",
   .filename = "qcamera.ts",
   .bitrate = QCAM_BITRATE,
+  .min_bitrate = QCAM_BITRATE,  // qcameras are uploaded, keep them as they are
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .frame_width = 526,
   .frame_height = 330,
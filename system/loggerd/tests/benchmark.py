@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Measures how much load loggerd absorbs. Publishes every logged service at its rate (scaled by RATE) plus
+# fake encoder streams, then reports throughput, per-service loss, write stalls and CPU usage from loggerStats.
+#   LOG_ROOT=/data/media/0/realdata RATE=4 ./benchmark.py
+import os
+import shutil
+import tempfile
+import time
+import numpy as np
+import psutil
+from pathlib import Path
+
+import cereal.messaging as messaging
+from cereal.services import SERVICE_LIST
+from openpilot.system.manager.process_config import managed_processes
+
+TIME = int(os.getenv("TIME", "30"))
+RATE = float(os.getenv("RATE", "1"))            # multiplier on each service's rate
+LIST_SIZE = int(os.getenv("LIST_SIZE", "0"))    # elements in list services like can, 0 for empty messages
+ENCODER_BITRATE = float(os.getenv("ENCODER_BITRATE", "1e7"))
+SEGMENT_LENGTH = int(os.getenv("SEGMENT_LENGTH", "60"))
+
+V4L2_BUF_FLAG_KEYFRAME = 8
+ENCODER_FPS = 20
+# service: bitrate
+ENCODERS = {
+  "roadEncodeData": ENCODER_BITRATE,
+  "wideRoadEncodeData": ENCODER_BITRATE,
+  "driverEncodeData": ENCODER_BITRATE,
+  "qRoadEncodeData": 256000,
+}
+SERVICES = [s for s, v in SERVICE_LIST.items() if v.should_log and v.frequency > 0 and s != "loggerStats"
+            and "encode" not in s.lower()]
+
+
+def service_message(service):
+  try:
+    msg = messaging.new_message(service, LIST_SIZE) if LIST_SIZE else messaging.new_message(service)
+  except Exception:
+    msg = messaging.new_message(service)
+  return msg.to_bytes()
+
+
+def encoder_message(service, encode_id, segment_num, payload):
+  keyframe = (encode_id - 1) % ENCODER_FPS == 0
+  msg = messaging.new_message(service)
+  dat = getattr(msg, service)
+  dat.idx.frameId = encode_id - 1
+  dat.idx.encodeId = encode_id
+  dat.idx.type = "fullHEVC"  # written as is, never remuxed
+  dat.idx.segmentNum = segment_num
+  dat.idx.flags = V4L2_BUF_FLAG_KEYFRAME if keyframe else 0
+  dat.idx.timestampEof = int(time.monotonic() * 1e9)
+  dat.width = 1928
+  dat.height = 1208
+  if keyframe:
+    dat.header = payload[:64]
+  dat.data = payload
+  return msg.to_bytes()
+
+
+def stall_percentiles(write_stalls, percentiles):
+  # bucket i holds writes of [2^i, 2^(i+1)) ms, report the upper edge of the bucket
+  counts = np.array(write_stalls)
+  if counts.sum() == 0:
+    return [0.] * len(percentiles)
+  cdf = np.cumsum(counts) / counts.sum()
+  return [2. ** (np.searchsorted(cdf, p / 100.) + 1) for p in percentiles]
+
+
+def received_count(stats, sent):
+  return sum(s.received for s in stats.services if s.name in sent)
+
+
+def run():
+  created_root = "LOG_ROOT" not in os.environ
+  if created_root:
+    os.environ["LOG_ROOT"] = tempfile.mkdtemp(dir="/dev/shm" if os.path.isdir("/dev/shm") else None)
+  log_root = os.environ["LOG_ROOT"]
+
+  pm = messaging.PubMaster(SERVICES + list(ENCODERS.keys()))
+  stats_sock = messaging.sub_sock("loggerStats", conflate=True, timeout=10000)
+  messages = {s: service_message(s) for s in SERVICES}
+  periods = {s: 1. / (SERVICE_LIST[s].frequency * RATE) for s in SERVICES}
+  periods.update({s: 1. / ENCODER_FPS for s in ENCODERS})
+  payloads = {s: os.urandom(int(bitrate / 8 / ENCODER_FPS)) for s, bitrate in ENCODERS.items()}
+
+  managed_processes["loggerd"].start()
+  time.sleep(3)  # wait for loggerd to subscribe
+  proc = psutil.Process(managed_processes["loggerd"].proc.pid)
+  cpu_start = sum(proc.cpu_times()[:2])
+
+  sent = dict.fromkeys(periods, 0)
+  start = time.monotonic()
+  next_send = dict.fromkeys(periods, start)
+  while (now := time.monotonic()) - start < TIME:
+    for s, t in next_send.items():
+      if now < t:
+        continue
+      if s in ENCODERS:
+        pm.send(s, encoder_message(s, sent[s] + 1, int((now - start) // SEGMENT_LENGTH), payloads[s]))
+      else:
+        pm.send(s, messages[s])
+      sent[s] += 1
+      next_send[s] = max(t + periods[s], now)
+    time.sleep(max(0., min(next_send.values()) - time.monotonic()))
+  duration = time.monotonic() - start
+
+  # loggerStats is published every 5s, wait for one covering everything that was sent
+  stats = None
+  while stats is None or (received_count(stats, sent) < sum(sent.values()) and time.monotonic() - start < duration + 7):
+    msg = messaging.recv_one(stats_sock)
+    if msg is None:
+      break
+    stats = msg.loggerStats
+  cpu = sum(proc.cpu_times()[:2]) - cpu_start
+  managed_processes["loggerd"].stop()
+
+  written_bytes = sum(f.stat().st_size for f in Path(log_root).rglob("*") if f.is_file())
+  if created_root:
+    shutil.rmtree(log_root)
+  if stats is None:
+    print("no loggerStats received")
+    return
+
+  received = {s.name: s for s in stats.services if s.name in sent}
+  total_received = received_count(stats, sent)
+  total_bytes = sum(s.bytes for s in received.values())
+  print(f"\n\nran loggerd for {duration:.1f}s, {RATE}x service rates, logging to {log_root}")
+  print(f"\tsent {sum(sent.values()) / duration:.0f} msg/s, received {total_received / duration:.0f} msg/s")
+  print(f"\treceived {total_bytes / duration / 1e6:.2f} MB/s, written to storage {written_bytes / duration / 1e6:.2f} MB/s")
+  print(f"\tcpu {cpu / duration * 100:.1f}% of one core")
+
+  write_stalls = list(stats.writeStalls)
+  p50, p90, p99 = stall_percentiles(write_stalls, [50, 90, 99])
+  print(f"\t{sum(write_stalls)} writes took 1ms or more ({sum(write_stalls) / max(total_received, 1) * 100:.3f}% of messages)")
+  print(f"\twrite stalls p50 < {p50:.0f}ms, p90 < {p90:.0f}ms, p99 < {p99:.0f}ms")
+
+  print("\tloss:")
+  for s in sorted(sent):
+    r = received[s] if s in received else None
+    lost = sent[s] - (r.received if r else 0)
+    if lost > 0 or (r and (r.lost or r.deferred)):
+      print(f"\t\t{s}: sent {sent[s]}, lost {lost}" + (f", encodeId gaps {r.lost}, deferred {r.deferred}" if r else ""))
+  print("\n\n")
+
+
+if __name__ == "__main__":
+  run()
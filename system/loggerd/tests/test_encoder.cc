@@ -0,0 +1,115 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "catch2/catch.hpp"
+#include "system/loggerd/encoder/bitrate_controller.h"
+#include "system/loggerd/encoder/ffmpeg_encoder.h"
+
+// road camera resolution
+const int WIDTH = 1928, HEIGHT = 1208, STRIDE = 2048;
+
+void init_frame(VisionBuf *buf) {
+  buf->allocate(STRIDE * HEIGHT * 3 / 2);
+  buf->init_yuv(WIDTH, HEIGHT, STRIDE, STRIDE * HEIGHT);
+  for (int i = 0; i < STRIDE * HEIGHT * 3 / 2; ++i) {
+    ((uint8_t *)buf->addr)[i] = rand();
+  }
+}
+
+TEST_CASE("EncoderFrame") {
+  VisionBuf buf;
+  init_frame(&buf);
+  EncoderFrame frame(&buf, {});
+
+  const int w = qcam_encoder_info.frame_width, h = qcam_encoder_info.frame_height;
+  const uint8_t *i420 = frame.i420(w, h);
+  const uint8_t *nv12 = frame.nv12(w, h);
+  REQUIRE(frame.i420(w, h) == i420);
+  REQUIRE(frame.nv12(w, h) == nv12);
+
+  // both are point sampled, the planes match
+  REQUIRE(memcmp(i420, nv12, w * h) == 0);
+  const uint8_t *u = i420 + w * h, *v = u + (w / 2) * (h / 2), *uv = nv12 + w * h;
+  for (int i = 0; i < (w / 2) * (h / 2); ++i) {
+    REQUIRE(uv[i * 2] == u[i]);
+    REQUIRE(uv[i * 2 + 1] == v[i]);
+  }
+
+  SECTION("released planes are reused") {
+    auto pool = std::make_shared<EncoderBufferPool>();
+    const uint8_t *planes = EncoderFrame(&buf, {}, 0, pool).i420(w, h);
+    REQUIRE(EncoderFrame(&buf, {}, 0, pool).i420(w, h) == planes);
+  }
+  SECTION("no planes of a reused buffer") {
+    EncoderFrame old_frame(&buf, {});
+    buf.set_frame_id(1);
+    REQUIRE(old_frame.i420(w, h) == nullptr);
+    REQUIRE(old_frame.nv12(w, h) == nullptr);
+  }
+  buf.free();
+}
+
+TEST_CASE("BitrateController") {
+  const uint64_t GB = 1024ULL * 1024 * 1024;
+  const BitrateController::Inputs healthy = {.free_bytes = 50 * GB, .output_rate = 5e6, .slow_writes = 0};
+  BitrateController controller;
+  REQUIRE(controller.update(healthy) == 1.0);
+  REQUIRE(controller.bitrate(main_road_encoder_info) == MAIN_BITRATE);
+
+  // steps down while loggerd falls behind, then stays within the bounds
+  auto slow = healthy;
+  slow.slow_writes = BitrateController::MAX_SLOW_WRITES + 1;
+  REQUIRE(controller.update(slow) == Approx(BitrateController::STEP));
+  for (int i = 0; i < 10; ++i) controller.update(slow);
+  REQUIRE(controller.scale() == BitrateController::MIN_SCALE);
+  REQUIRE(controller.bitrate(main_road_encoder_info) == main_road_encoder_info.min_bitrate);
+  REQUIRE(controller.bitrate(qcam_encoder_info) == QCAM_BITRATE);
+
+  // steps back up only after a few healthy updates in a row
+  for (int i = 0; i < BitrateController::RECOVERY_UPDATES - 1; ++i) {
+    REQUIRE(controller.update(healthy) == BitrateController::MIN_SCALE);
+  }
+  REQUIRE(controller.update(healthy) > BitrateController::MIN_SCALE);
+  for (int i = 0; i < 100; ++i) controller.update(healthy);
+  REQUIRE(controller.scale() == 1.0);
+
+  // less than 10 minutes of recording left
+  auto filling = healthy;
+  filling.free_bytes = 4 * GB;
+  filling.output_rate = 10e6;
+  REQUIRE(controller.update(filling) < 1.0);
+
+  auto critical = healthy;
+  critical.free_bytes = GB / 2;
+  REQUIRE(controller.update(critical) == BitrateController::MIN_SCALE);
+}
+
+TEST_CASE("FfmpegEncoder benchmark", "[.][benchmark]") {
+  // set ENCODER_CODEC to compare codecs, e.g. libx264 takes NV12 directly
+  VisionBuf buf;
+  init_frame(&buf);
+  const int frames = 100;
+
+  printf("%-20s %10s %10s\n", "encoder", "cpu ms", "frames/s");
+  for (const auto &encoder_info : {main_road_encoder_info, qcam_encoder_info}) {
+    FfmpegEncoder encoder(encoder_info, WIDTH, HEIGHT);
+    encoder.encoder_open(nullptr);
+
+    std::clock_t cpu_start = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+      VisionIpcBufExtra extra = {.frame_id = (uint32_t)i};
+      buf.set_frame_id(i);
+      EncoderFrame frame(&buf, extra);
+      REQUIRE(encoder.encode_frame(&frame) >= 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu_ms = (std::clock() - cpu_start) * 1000.0 / CLOCKS_PER_SEC;
+    encoder.encoder_close();
+    printf("%-20s %10.1f %10.1f\n", encoder_info.publish_name, cpu_ms, frames / seconds);
+  }
+  buf.free();
+}
@@ -1,18 +1,37 @@
+#include <cstdio>
+#include <ctime>
+
 #include "catch2/catch.hpp"
+#include "msgq/impl_msgq.h"
 #include "system/loggerd/logger.h"
+#include "system/loggerd/video_writer.h"
 
 typedef cereal::Sentinel::SentinelType SentinelType;
 
-void verify_segment(const std::string &route_path, int segment, int max_segment, int required_event_cnt) {
+std::string decompress_frames(const std::string &data) {
+  auto frames = zstd_index::read(data.data(), data.size());
+  REQUIRE(!frames.empty());
+  std::string out;
+  for (auto &f : frames) {
+    std::string frame(f.decompressed_size, '\0');
+    size_t ret = ZSTD_decompress(frame.data(), frame.size(), data.data() + f.offset, f.compressed_size);
+    REQUIRE(ret == f.decompressed_size);
+    out += frame;
+  }
+  return out;
+}
+
+void verify_segment(const std::string &route_path, int segment, int max_segment, int required_event_cnt, bool compressed = false) {
   const std::string segment_path = route_path + "--" + std::to_string(segment);
   SentinelType begin_sentinel = segment == 0 ? SentinelType::START_OF_ROUTE : SentinelType::START_OF_SEGMENT;
   SentinelType end_sentinel = segment == max_segment - 1 ? SentinelType::END_OF_ROUTE : SentinelType::END_OF_SEGMENT;
 
   REQUIRE(!util::file_exists(segment_path + "/rlog.lock"));
   for (const char *fn : {"/rlog", "/qlog"}) {
-    const std::string log_file = segment_path + fn;
+    const std::string log_file = segment_path + fn + (compressed ? ".zst" : "");
     std::string log = util::read_file(log_file);
     REQUIRE(!log.empty());
+    if (compressed) log = decompress_frames(log);
     int event_cnt = 0, i = 0;
     kj::ArrayPtr<const capnp::word> words((capnp::word *)log.data(), log.size() / sizeof(capnp::word));
     while (words.size() > 0) {
@@ -72,3 +91,252 @@ TEST_CASE("logger") {
     verify_segment(log_root + "/" + route_name, i, segment_cnt, 1);
   }
 }
+
+TEST_CASE("AsyncFileWriter") {
+  const std::string path = "/tmp/test_async_file_writer";
+  const size_t buffer_size = 1000, max_buffers = 2;
+  std::string expected;
+  FILE *f = fopen(path.c_str(), "wb");
+  REQUIRE(f != nullptr);
+  {
+    AsyncFileWriter writer(f, buffer_size, max_buffers);
+    for (int i = 0; i < 5000; ++i) {
+      // writes smaller and larger than a buffer
+      std::string data = std::to_string(i) + std::string(i % 3000, 'a' + i % 26);
+      expected += data;
+      writer.write(data.data(), data.size());
+    }
+    auto stats = writer.stats();
+    REQUIRE(stats.bytes_written <= expected.size());
+    REQUIRE(stats.max_queue_depth <= max_buffers);
+  }
+  fclose(f);
+  REQUIRE(util::read_file(path) == expected);
+}
+
+TEST_CASE("AsyncFileWriter writes old buffers without new writes") {
+  const std::string path = "/tmp/test_async_file_writer_age";
+  FILE *f = fopen(path.c_str(), "wb");
+  REQUIRE(f != nullptr);
+  {
+    AsyncFileWriter writer(f);
+    writer.write("hello", 5);
+    util::sleep_for((int)AsyncFileWriter::MAX_BUFFER_AGE_MS + 500);
+    REQUIRE(writer.stats().bytes_written == 5);
+  }
+  fclose(f);
+  REQUIRE(util::read_file(path) == "hello");
+}
+
+TEST_CASE("logger with zstd") {
+  const int segment_cnt = 3;
+  const int event_cnt = 25000;
+  const std::string log_root = "/tmp/test_logger_zstd";
+  system(("rm " + log_root + " -rf").c_str());
+  std::string route_name;
+  {
+    LoggerState logger(log_root, true);
+    route_name = logger.routeName();
+    for (int i = 0; i < segment_cnt; ++i) {
+      REQUIRE(logger.next());
+      REQUIRE(!util::file_exists(logger.segmentPath() + "/rlog"));
+      for (int j = 0; j < event_cnt; ++j) {
+        write_msg(&logger);
+      }
+    }
+    logger.setExitSignal(1);
+  }
+  for (int i = 0; i < segment_cnt; ++i) {
+    verify_segment(log_root + "/" + route_name, i, segment_cnt, event_cnt, true);
+    // compressed logs only have the zstd frame index
+    const std::string segment_path = log_root + "/" + route_name + "--" + std::to_string(i);
+    REQUIRE(!util::file_exists(segment_path + "/rlog.idx"));
+    REQUIRE(!util::file_exists(segment_path + "/qlog.idx"));
+  }
+}
+
+TEST_CASE("ZstdFile") {
+  const std::string path = "/tmp/test_zstd_file.zst";
+  const int events_per_frame = 100;
+  const int event_cnt = 1050;
+  std::string raw;
+  {
+    ZstdFile file(path, false, ZstdFile::ZSTD_LEVEL, events_per_frame);
+    for (int i = 0; i < event_cnt; ++i) {
+      MessageBuilder msg;
+      auto event = msg.initEvent();
+      event.setLogMonoTime((i + 1) * 1000);
+      event.initClocks().setWallTimeNanos(i);
+      auto bytes = msg.toBytes();
+      raw.append((const char *)bytes.begin(), bytes.size());
+      file.write(bytes);
+    }
+  }
+
+  std::string data = util::read_file(path);
+  auto frames = zstd_index::read(data.data(), data.size());
+  REQUIRE(frames.size() == (event_cnt + events_per_frame - 1) / events_per_frame);
+  for (int i = 0; i < frames.size(); ++i) {
+    REQUIRE(frames[i].first_mono_time == (i * events_per_frame + 1) * 1000);
+  }
+  REQUIRE(zstd_index::find(frames, 0) == 0);
+  REQUIRE(zstd_index::find(frames, 150 * 1000) == 1);
+  REQUIRE(zstd_index::find(frames, 201 * 1000) == 2);
+  REQUIRE(zstd_index::find(frames, -1) == frames.size() - 1);
+  REQUIRE(decompress_frames(data) == raw);
+
+  // the index is a skippable frame, regular zstd decoders must ignore it
+  std::string out(raw.size() + 1, '\0');
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  ZSTD_inBuffer input = {data.data(), data.size(), 0};
+  ZSTD_outBuffer output = {out.data(), out.size(), 0};
+  while (input.pos < input.size) {
+    size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+    REQUIRE(!ZSTD_isError(ret));
+  }
+  ZSTD_freeDCtx(dctx);
+  out.resize(output.pos);
+  REQUIRE(out == raw);
+}
+
+TEST_CASE("ZstdFile flushes old frames") {
+  const std::string path = "/tmp/test_zstd_file_age.zst";
+  {
+    ZstdFile file(path);
+    for (int i = 0; i < 3; ++i) {
+      MessageBuilder msg;
+      msg.initEvent().setLogMonoTime(i + 1);
+      file.write(msg.toBytes());
+      if (i == 0) util::sleep_for((int)ZstdFile::FRAME_MAX_AGE_MS + 100);
+    }
+  }
+  // the first frame was closed by the second event, the third event starts a new one
+  std::string data = util::read_file(path);
+  auto frames = zstd_index::read(data.data(), data.size());
+  REQUIRE(frames.size() == 2);
+  REQUIRE(frames[0].first_mono_time == 1);
+  REQUIRE(frames[1].first_mono_time == 3);
+}
+
+TEST_CASE("ZstdFile benchmark", "[.][benchmark]") {
+  // ~60s of can traffic at 100hz on 3 buses with slowly changing signals, plus clocks
+  std::vector<kj::Array<capnp::word>> events;
+  uint64_t mono_time = 0;
+  for (int i = 0; i < 6000; ++i) {
+    mono_time += 10000000;
+    MessageBuilder msg;
+    auto event = msg.initEvent();
+    event.setLogMonoTime(mono_time);
+    auto can = event.initCan(60);
+    for (int j = 0; j < can.size(); ++j) {
+      uint8_t dat[8] = {};
+      for (int k = 0; k < 8; ++k) dat[k] = (i * (j + 1) >> k) & 0xff;
+      can[j].setAddress(0x100 + j * 7);
+      can[j].setSrc(j % 3);
+      can[j].setDat(kj::arrayPtr(dat, 8));
+    }
+    events.push_back(capnp::messageToFlatArray(msg));
+
+    MessageBuilder clocks;
+    clocks.initEvent().initClocks().setWallTimeNanos(mono_time);
+    events.push_back(capnp::messageToFlatArray(clocks));
+  }
+
+  size_t raw_size = 0;
+  for (auto &e : events) raw_size += e.asBytes().size();
+
+  const std::string path = "/tmp/test_zstd_benchmark";
+  printf("%-8s %12s %12s %8s %10s %10s\n", "level", "raw MB", "written MB", "ratio", "cpu ms", "MB/s");
+  for (int level : {0, 1, 3, 5, 9}) {
+    std::clock_t cpu_start = std::clock();
+    {
+      if (level == 0) {
+        RawFile file(path);
+        for (auto &e : events) file.write(e.asBytes());
+      } else {
+        ZstdFile file(path, false, level);
+        for (auto &e : events) file.write(e.asBytes());
+      }
+    }
+    double cpu_ms = (std::clock() - cpu_start) * 1000.0 / CLOCKS_PER_SEC;
+    size_t written = util::read_file(path).size();
+    printf("%-8s %12.2f %12.2f %8.2f %10.1f %10.1f\n", level == 0 ? "raw" : std::to_string(level).c_str(),
+           raw_size / 1e6, written / 1e6, (double)raw_size / written, cpu_ms, raw_size / 1e3 / std::max(cpu_ms, 1e-3));
+  }
+}
+
+TEST_CASE("log index") {
+  const std::string log_root = "/tmp/test_logger_index";
+  system(("rm " + log_root + " -rf").c_str());
+  const int event_cnt = 20000;
+  std::string segment_path;
+  {
+    LoggerState logger(log_root, false);
+    REQUIRE(logger.next());
+    segment_path = logger.segmentPath();
+    for (int i = 0; i < event_cnt; ++i) {
+      write_msg(&logger);
+      // large, sparse events in between to split the clocks blocks
+      MessageBuilder msg;
+      msg.initEvent().initCan(i % 1000 == 0 ? 5000 : 1);
+      logger.write(msg.toBytes(), false);
+    }
+  }
+
+  for (auto [name, has_can] : {std::pair{"/rlog", true}, std::pair{"/qlog", false}}) {
+    const std::string log = util::read_file(segment_path + name);
+    auto index = log_index::read(util::read_file(segment_path + name + ".idx"));
+    REQUIRE(index.count(cereal::Event::CLOCKS) == 1);
+    REQUIRE(index.count(cereal::Event::CAN) == has_can);
+    REQUIRE(index.count(cereal::Event::INIT_DATA) == 1);
+
+    auto &blocks = index[cereal::Event::CLOCKS];
+    REQUIRE(blocks.size() > 1);
+    for (int i = 1; i < blocks.size(); ++i) {
+      REQUIRE(blocks[i].offset >= blocks[i - 1].offset + blocks[i - 1].size);
+      REQUIRE(blocks[i].start_mono_time >= blocks[i - 1].end_mono_time);
+    }
+
+    // reading only the ranges of a service yields all of its events
+    auto ranges = log_index::ranges(index, [](uint16_t which) { return which == cereal::Event::CLOCKS; });
+    int clocks_cnt = 0;
+    for (auto [offset, size] : ranges) {
+      REQUIRE(offset + size <= log.size());
+      kj::ArrayPtr<const capnp::word> words((const capnp::word *)(log.data() + offset), size / sizeof(capnp::word));
+      while (words.size() > 0) {
+        capnp::FlatArrayMessageReader reader(words);
+        clocks_cnt += reader.getRoot<cereal::Event>().which() == cereal::Event::CLOCKS;
+        words = kj::arrayPtr(reader.getEnd(), words.end());
+      }
+    }
+    REQUIRE(clocks_cnt == event_cnt);
+  }
+}
+
+TEST_CASE("VideoWriter") {
+  const std::string path = "/tmp/test_video_writer";
+  system(("rm " + path + " -rf && mkdir -p " + path).c_str());
+
+  auto flush_on_keyframes = GENERATE(true, false);
+  std::string expected;
+  {
+    VideoWriter writer(path.c_str(), "fcamera.hevc", false, 1928, 1208, 20, cereal::EncodeIndex::Type::FULL_H_E_V_C,
+                       {.max_bytes = 64 * 1024, .keyframes = flush_on_keyframes});
+    REQUIRE(util::file_exists(path + "/fcamera.hevc.lock"));
+    for (int i = 0; i < 1000; ++i) {
+      std::string packet = util::random_string(rand() % 10000 + 1);
+      expected += packet;
+      if (i % 2 == 0) {
+        writer.write((uint8_t *)packet.data(), packet.size(), i * 50000, i == 0, i % 20 == 0);
+      } else {
+        // the payload stays in the message until it's written
+        auto msg = std::make_unique<MSGQMessage>();
+        msg->init(packet.data(), packet.size());
+        const uint8_t *data = (const uint8_t *)msg->getData();
+        writer.write(std::move(msg), data, packet.size(), i * 50000, false);
+      }
+    }
+  }
+  REQUIRE(!util::file_exists(path + "/fcamera.hevc.lock"));
+  REQUIRE(util::read_file(path + "/fcamera.hevc") == expected);
+}
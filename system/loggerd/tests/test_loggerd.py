@@ -28,7 +28,8 @@ from openpilot.common.transformations.camera import DEVICE_CAMERAS
 SentinelType = log.Sentinel.SentinelType
 
 CEREAL_SERVICES = [f for f in log.Event.schema.union_fields if f in SERVICE_LIST
-                   and SERVICE_LIST[f].should_log and "encode" not in f.lower()]
+                   and SERVICE_LIST[f].should_log and "encode" not in f.lower()
+                   and f != "loggerStats"]
 
 
 class TestLoggerd:
@@ -282,3 +283,45 @@ class TestLoggerd:
     segment_dir = self._get_latest_log_dir()
     assert getxattr(segment_dir, PRESERVE_ATTR_NAME) is None
 
+
+  def test_priority_services_under_load(self):
+    # flood a bulk service, every message of the priority services must still be logged
+    priority_services = ["carState", "carControl", "sendcan"]
+    services = priority_services + ["can"]
+    pm = messaging.PubMaster(services)
+    stats_sock = messaging.sub_sock("loggerStats", timeout=1000)
+
+    managed_processes["loggerd"].start()
+    for s in services:
+      assert pm.wait_for_readers_to_update(s, timeout=5)
+
+    sent_cnt = defaultdict(int)
+    for _ in range(1000):
+      for _ in range(10):
+        pm.send("can", messaging.new_message("can", 100))
+        sent_cnt["can"] += 1
+      for s in priority_services:
+        pm.send(s, messaging.new_message(s))
+        sent_cnt[s] += 1
+    for s in services:
+      assert pm.wait_for_readers_to_update(s, timeout=5)
+
+    # the first stats published after everything was read
+    messaging.drain_sock_raw(stats_sock)
+    stats = None
+    with Timeout(15, "no loggerStats"):
+      while stats is None:
+        stats = messaging.recv_one(stats_sock)
+    managed_processes["loggerd"].stop()
+
+    logged_cnt = defaultdict(int)
+    for m in LogReader(os.path.join(self._get_latest_log_dir(), "rlog")):
+      logged_cnt[m.which()] += 1
+
+    service_stats = {s.name: s for s in stats.loggerStats.services}
+    for s in services:
+      st = service_stats[s]
+      assert st.written == st.received == logged_cnt[s], f"{s}: {st.received=} {st.written=} logged={logged_cnt[s]}"
+      assert st.lost == 0
+    for s in priority_services:
+      assert logged_cnt[s] == sent_cnt[s], f"expected {sent_cnt[s]} {s} msgs, got {logged_cnt[s]}"
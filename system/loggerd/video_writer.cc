@@ -5,8 +5,9 @@
 #include "common/swaglog.h"
 #include "common/util.h"
 
-VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec)
-  : remuxing(remuxing) {
+VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec,
+                         VideoFlushPolicy flush_policy)
+  : policy(flush_policy), remuxing(remuxing) {
   vid_path = util::string_format("%s/%s", path, filename);
   lock_path = util::string_format("%s/%s.lock", path, filename);
 
@@ -47,19 +48,84 @@ VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing,
   } else {
     this->of = util::safe_fopen(this->vid_path.c_str(), "wb");
     assert(this->of);
+    write_buf.reserve(policy.max_bytes + 512 * 1024);
   }
+  thread = std::thread(&VideoWriter::writeThread, this);
+}
+
+VideoWriter::Packet &VideoWriter::enqueue(std::unique_lock<std::mutex> &lk) {
+  if (queue.size() >= MAX_QUEUED_PACKETS) {
+    ++stalls;
+    cv.wait(lk, [this]() { return queue.size() < MAX_QUEUED_PACKETS; });
+  }
+  return queue.emplace_back();
 }
 
 void VideoWriter::write(uint8_t *data, int len, long long timestamp, bool codecconfig, bool keyframe) {
-  if (of && data) {
-    size_t written = util::safe_fwrite(data, 1, len, of);
-    if (written != len) {
-      LOGE("failed to write file.errno=%d", errno);
-    }
+  std::unique_lock lk(lock);
+  Packet &pkt = enqueue(lk);
+  if (!free_data.empty()) {
+    pkt.copy = std::move(free_data.back());
+    free_data.pop_back();
+  }
+  if (data) {
+    pkt.copy.assign(data, data + len);
+  } else {
+    pkt.copy.clear();
+  }
+  pkt.data = pkt.copy.data();
+  pkt.len = pkt.copy.size();
+  pkt.timestamp = timestamp;
+  pkt.codecconfig = codecconfig;
+  pkt.keyframe = keyframe;
+  cv.notify_all();
+}
+
+void VideoWriter::write(std::unique_ptr<Message> msg, const uint8_t *data, int len, long long timestamp, bool keyframe) {
+  std::unique_lock lk(lock);
+  Packet &pkt = enqueue(lk);
+  pkt.data = data;
+  pkt.len = len;
+  pkt.msg = std::move(msg);
+  pkt.timestamp = timestamp;
+  pkt.codecconfig = false;
+  pkt.keyframe = keyframe;
+  cv.notify_all();
+}
+
+void VideoWriter::writeThread() {
+  util::set_thread_name("video_writer");
+  std::unique_lock lk(lock);
+  while (true) {
+    cv.wait(lk, [this]() { return exit_writer || !queue.empty(); });
+    if (queue.empty()) break;
+
+    Packet pkt = std::move(queue.front());
+    queue.pop_front();
+    cv.notify_all();
+    lk.unlock();
+
+    writePacket(pkt);
+    pkt.msg.reset();
+
+    lk.lock();
+    if (pkt.copy.capacity() > 0) free_data.push_back(std::move(pkt.copy));
+  }
+}
+
+void VideoWriter::writePacket(const Packet &pkt) {
+  const uint8_t *data = pkt.data;
+  const int len = pkt.len;
+
+  if (of) {
+    // everything before a keyframe is a complete GOP
+    if (pkt.keyframe && policy.keyframes) flush();
+    write_buf.insert(write_buf.end(), data, data + len);
+    if (write_buf.size() >= policy.max_bytes) flush();
   }
 
   if (remuxing) {
-    if (codecconfig) {
+    if (pkt.codecconfig) {
       if (len > 0) {
         codec_ctx->extradata = (uint8_t*)av_mallocz(len + AV_INPUT_BUFFER_PADDING_SIZE);
         codec_ctx->extradata_size = len;
@@ -70,32 +136,55 @@ void VideoWriter::write(uint8_t *data, int len, long long timestamp, bool codecc
       err = avformat_write_header(ofmt_ctx, NULL);
       assert(err >= 0);
     } else {
+      // small packets are coalesced in the avio buffer
+      if (pkt.keyframe && policy.keyframes) avio_flush(ofmt_ctx->pb);
+
       // input timestamps are in microseconds
       AVRational in_timebase = {1, 1000000};
 
-      AVPacket pkt;
-      av_init_packet(&pkt);
-      pkt.data = data;
-      pkt.size = len;
+      AVPacket av_pkt;
+      av_init_packet(&av_pkt);
+      av_pkt.data = (uint8_t *)data;
+      av_pkt.size = len;
 
       enum AVRounding rnd = static_cast<enum AVRounding>(AV_ROUND_NEAR_INF|AV_ROUND_PASS_MINMAX);
-      pkt.pts = pkt.dts = av_rescale_q_rnd(timestamp, in_timebase, ofmt_ctx->streams[0]->time_base, rnd);
-      pkt.duration = av_rescale_q(50*1000, in_timebase, ofmt_ctx->streams[0]->time_base);
+      av_pkt.pts = av_pkt.dts = av_rescale_q_rnd(pkt.timestamp, in_timebase, ofmt_ctx->streams[0]->time_base, rnd);
+      av_pkt.duration = av_rescale_q(50*1000, in_timebase, ofmt_ctx->streams[0]->time_base);
 
-      if (keyframe) {
-        pkt.flags |= AV_PKT_FLAG_KEY;
+      if (pkt.keyframe) {
+        av_pkt.flags |= AV_PKT_FLAG_KEY;
       }
 
       // TODO: can use av_write_frame for non raw?
-      int err = av_interleaved_write_frame(ofmt_ctx, &pkt);
-      if (err < 0) { LOGW("ts encoder write issue len: %d ts: %lld", len, timestamp); }
+      int err = av_interleaved_write_frame(ofmt_ctx, &av_pkt);
+      if (err < 0) { LOGW("ts encoder write issue len: %d ts: %lld", len, pkt.timestamp); }
 
-      av_packet_unref(&pkt);
+      av_packet_unref(&av_pkt);
     }
   }
 }
 
+// Writes the buffered raw stream to the file.
+void VideoWriter::flush() {
+  if (write_buf.empty()) return;
+
+  size_t written = util::safe_fwrite(write_buf.data(), 1, write_buf.size(), of);
+  if (written != write_buf.size()) {
+    LOGE("failed to write file.errno=%d", errno);
+  }
+  util::safe_fflush(of);
+  write_buf.clear();
+}
+
 VideoWriter::~VideoWriter() {
+  {
+    std::lock_guard lk(lock);
+    exit_writer = true;
+  }
+  cv.notify_all();
+  thread.join();
+  if (stalls > 0) LOGW("%s: writer queue was full %d times", vid_path.c_str(), stalls);
+
   if (this->remuxing) {
     int err = av_write_trailer(this->ofmt_ctx);
     if (err != 0) LOGE("av_write_trailer failed %d", err);
@@ -104,7 +193,7 @@ VideoWriter::~VideoWriter() {
     if (err != 0) LOGE("avio_closep failed %d", err);
     avformat_free_context(this->ofmt_ctx);
   } else {
-    util::safe_fflush(this->of);
+    flush();
     fclose(this->of);
     this->of = nullptr;
   }
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -9,17 +15,55 @@ extern "C" {
 
 #include "cereal/messaging/messaging.h"
 
+// When the writer thread hands buffered video to the file. Flushing before every keyframe keeps the file
+// ending on a GOP boundary, so a crash loses at most the GOP being written.
+struct VideoFlushPolicy {
+  size_t max_bytes = 1024 * 1024;  // raw streams are written in chunks of about this size
+  bool keyframes = true;
+};
+
+// Muxing and file I/O are done on a dedicated thread, write() only queues the packet.
 class VideoWriter {
 public:
-  VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec);
+  VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec,
+              VideoFlushPolicy flush_policy = {});
+  // queues a copy of data
   void write(uint8_t *data, int len, long long timestamp, bool codecconfig, bool keyframe);
+  // queues data without copying it, it must point into msg. msg is freed after the packet is written
+  void write(std::unique_ptr<Message> msg, const uint8_t *data, int len, long long timestamp, bool keyframe);
   ~VideoWriter();
+
+  static constexpr size_t MAX_QUEUED_PACKETS = 64;  // write() waits when this many packets are queued
+
 private:
+  struct Packet {
+    const uint8_t *data = nullptr;
+    int len = 0;
+    std::vector<uint8_t> copy;
+    std::unique_ptr<Message> msg;  // owns data when it wasn't copied
+    long long timestamp = 0;
+    bool codecconfig = false, keyframe = false;
+  };
+  Packet &enqueue(std::unique_lock<std::mutex> &lk);
+  void writeThread();
+  void writePacket(const Packet &pkt);
+  void flush();
+
   std::string vid_path, lock_path;
   FILE *of = nullptr;
+  const VideoFlushPolicy policy;
+  std::vector<uint8_t> write_buf;
 
   AVCodecContext *codec_ctx;
   AVFormatContext *ofmt_ctx;
   AVStream *out_stream;
   bool remuxing;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<Packet> queue;
+  std::vector<std::vector<uint8_t>> free_data;  // packet buffers to reuse
+  bool exit_writer = false;
+  int stalls = 0;
+  std::thread thread;
 };
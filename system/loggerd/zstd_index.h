@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compressed logs are a sequence of independent zstd frames followed by a skippable frame holding the seek index:
+//   [frame 0]...[frame n-1][magic][index size][n * Entry][Footer]
+// Standard zstd decoders skip the index, readers that find it can decompress frames in parallel or seek to a time.
+namespace zstd_index {
+
+constexpr uint32_t SKIPPABLE_MAGIC = 0x184D2A5C;
+constexpr uint32_t FOOTER_MAGIC = 0x5844494F;  // "OIDX"
+
+struct Entry {
+  uint32_t compressed_size;
+  uint32_t decompressed_size;
+  uint64_t first_mono_time;  // logMonoTime of the first event in the frame
+};
+
+struct Footer {
+  uint32_t num_frames;
+  uint32_t magic;
+};
+
+struct Frame {
+  size_t offset;
+  size_t compressed_size;
+  size_t decompressed_size;
+  uint64_t first_mono_time;
+};
+
+// Returns the frames of a compressed log, empty if it has no valid index.
+inline std::vector<Frame> read(const char *data, size_t size) {
+  std::vector<Frame> frames;
+  Footer footer;
+  if (size < sizeof(footer) + 8) return frames;
+
+  memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+  const size_t index_size = (size_t)footer.num_frames * sizeof(Entry) + sizeof(footer);
+  if (footer.magic != FOOTER_MAGIC || index_size + 8 > size) return frames;
+
+  uint32_t header[2];
+  const char *index = data + size - index_size;
+  memcpy(header, index - 8, sizeof(header));
+  if (header[0] != SKIPPABLE_MAGIC || header[1] != index_size) return frames;
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < footer.num_frames; ++i) {
+    Entry e;
+    memcpy(&e, index + i * sizeof(Entry), sizeof(e));
+    frames.push_back({offset, e.compressed_size, e.decompressed_size, e.first_mono_time});
+    offset += e.compressed_size;
+  }
+  if (offset + index_size + 8 != size) frames.clear();
+  return frames;
+}
+
+// Returns the index of the frame to start decompressing from to get the events after mono_time.
+// Events are logged roughly in time order, so this is the last frame that starts before mono_time.
+inline size_t find(const std::vector<Frame> &frames, uint64_t mono_time) {
+  auto it = std::upper_bound(frames.begin(), frames.end(), mono_time,
+                             [](uint64_t t, const Frame &f) { return t < f.first_mono_time; });
+  return it == frames.begin() ? 0 : it - frames.begin() - 1;
+}
+
+}  // namespace zstd_index
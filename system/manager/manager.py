@@ -48,9 +48,7 @@ def manager_init() -> None:
     params.put_bool("RecordFront", True)
 
   # set unset params
-  for k, v in default_params:
-    if params.get(k) is None:
-      params.put(k, v)
+  params.put_many({k: v for k, v in default_params if params.get(k) is None})
 
   # Create folders needed for msgq
   try:
@@ -61,15 +59,17 @@ def manager_init() -> None:
     print("WARNING: failed to make /dev/shm")
 
   # set version params
-  params.put("Version", build_metadata.openpilot.version)
-  params.put("TermsVersion", terms_version)
-  params.put("TrainingVersion", training_version)
-  params.put("GitCommit", build_metadata.openpilot.git_commit)
-  params.put("GitCommitDate", build_metadata.openpilot.git_commit_date)
-  params.put("GitBranch", build_metadata.channel)
-  params.put("GitRemote", build_metadata.openpilot.git_origin)
-  params.put_bool("IsTestedBranch", build_metadata.tested_channel)
-  params.put_bool("IsReleaseBranch", build_metadata.release_channel)
+  params.put_many({
+    "Version": build_metadata.openpilot.version,
+    "TermsVersion": terms_version,
+    "TrainingVersion": training_version,
+    "GitCommit": build_metadata.openpilot.git_commit,
+    "GitCommitDate": build_metadata.openpilot.git_commit_date,
+    "GitBranch": build_metadata.channel,
+    "GitRemote": build_metadata.openpilot.git_origin,
+    "IsTestedBranch": "1" if build_metadata.tested_channel else "0",
+    "IsReleaseBranch": "1" if build_metadata.release_channel else "0",
+  })
 
   # set dongle id
   reg_res = register(show_spinner=True)
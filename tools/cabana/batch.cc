@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "tools/cabana/dbc/dbcfile.h"
+#include "tools/cabana/streams/eventlist.h"
+#include "tools/cabana/tools/signalsearch.h"
+#include "tools/cabana/tools/similarbits.h"
+#include "tools/cabana/utils/export.h"
+#include "tools/replay/route.h"
+
+// Headless analysis of many routes on a worker pool, without a GUI or the global stream:
+//   stats   - per-signal count, min, max, mean and stddev of every DBC signal
+//   find    - candidate signals (start bit, size) that take the given raw value
+//   similar - bits that follow the source bit, see FindSimilarBitsDlg
+//   export  - CSV files of the decoded DBC messages (and optionally all raw events)
+
+struct SegmentEvents {
+  int seg_num;
+  QString file;
+  std::unique_ptr<MonotonicBuffer> buffer;
+  std::vector<const CanEvent *> events;
+};
+
+struct RouteEvents {
+  QString name;
+  uint64_t start_mono_time = 0;
+  CanEventList all_events;
+  std::map<MessageId, CanEventList> events;
+};
+
+struct FindOptions {
+  double value;
+  int min_size, max_size;
+  bool is_little_endian, is_signed;
+};
+
+struct SimilarOptions {
+  MessageId src;
+  int byte_idx, bit_idx;
+  uint8_t find_bus;
+  bool equal;
+  uint32_t min_msgs;
+};
+
+static void loadSegment(SegmentEvents &seg) {
+  static const std::vector<bool> filters = []() {
+    std::vector<bool> f(capnp::Schema::from<cereal::Event>().asStruct().getUnionFields().size());
+    f[cereal::Event::Which::CAN] = true;
+    return f;
+  }();
+
+  LogReader log(filters);
+  if (!log.load(seg.file.toStdString())) {
+    qWarning() << "failed to load" << seg.file;
+    return;
+  }
+
+  seg.buffer = std::make_unique<MonotonicBuffer>(4 * 1024 * 1024);
+  for (const Event &e : log.events) {
+    capnp::FlatArrayMessageReader reader(e.data);
+    for (const auto &c : reader.getRoot<cereal::Event>().getCan()) {
+      auto dat = c.getDat();
+      CanEvent *ce = (CanEvent *)seg.buffer->allocate(sizeof(CanEvent) + dat.size());
+      ce->src = c.getSrc();
+      ce->address = c.getAddress();
+      ce->mono_time = e.mono_time;
+      ce->size = dat.size();
+      memcpy(ce->dat, (uint8_t *)dat.begin(), ce->size);
+      seg.events.push_back(ce);
+    }
+  }
+}
+
+static void mergeSegments(RouteEvents &route, const std::vector<SegmentEvents> &segments) {
+  std::map<MessageId, std::vector<const CanEvent *>> msg_events;
+  for (const auto &seg : segments) {
+    for (auto e : seg.events) {
+      msg_events[{.source = e->src, .address = e->address}].push_back(e);
+    }
+    route.all_events.merge(seg.events);
+  }
+  for (const auto &[id, events] : msg_events) {
+    route.events[id].merge(events);
+  }
+  route.start_mono_time = route.all_events.empty() ? 0 : route.all_events.front()->mono_time;
+}
+
+// Runs f on the messages of the route in parallel, the results are in message order.
+template <typename T, typename Func>
+static std::vector<T> mapMessages(const RouteEvents &route, Func f) {
+  std::vector<const std::pair<const MessageId, CanEventList> *> msgs;
+  for (const auto &m : route.events) msgs.push_back(&m);
+
+  std::vector<T> results(msgs.size());
+  std::vector<int> indices(msgs.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  QtConcurrent::blockingMap(indices, [&](int i) { results[i] = f(msgs[i]->first, msgs[i]->second); });
+  return results;
+}
+
+static QStringList signalStats(const RouteEvents &route, const DBCFile &dbc) {
+  QStringList rows;
+  for (const QStringList &r : mapMessages<QStringList>(route, [&](const MessageId &id, const CanEventList &events) {
+    QStringList msg_rows;
+    auto it = dbc.getMessages().find(id.address);
+    if (it == dbc.getMessages().end()) return msg_rows;
+
+    for (const cabana::Signal *sig : it->second.getSignals()) {
+      double min = std::numeric_limits<double>::max(), max = std::numeric_limits<double>::lowest();
+      double sum = 0, sum_sq = 0, value = 0;
+      uint64_t count = 0;
+      for (const CanEvent *e : events) {
+        if (sig->getValue(e->dat, e->size, &value)) {
+          min = std::min(min, value);
+          max = std::max(max, value);
+          sum += value;
+          sum_sq += value * value;
+          ++count;
+        }
+      }
+      if (count == 0) continue;
+
+      const double mean = sum / count;
+      const double stddev = std::sqrt(std::max(0.0, sum_sq / count - mean * mean));
+      msg_rows << QString("%1,%2,0x%3,%4,%5,%6,%7,%8,%9,%10")
+                  .arg(route.name).arg(id.source).arg(id.address, 1, 16).arg(it->second.name).arg(sig->name).arg(count)
+                  .arg(min, 0, 'g', 10).arg(max, 0, 'g', 10).arg(mean, 0, 'g', 10).arg(stddev, 0, 'g', 10);
+    }
+    return msg_rows;
+  })) {
+    rows << r;
+  }
+  return rows;
+}
+
+static QStringList findSignals(const RouteEvents &route, const FindOptions &opts) {
+  QStringList rows;
+  for (const QStringList &r : mapMessages<QStringList>(route, [&](const MessageId &id, const CanEventList &events) {
+    QStringList msg_rows;
+    if (events.empty()) return msg_rows;
+
+    cabana::Signal props = {};
+    props.is_little_endian = opts.is_little_endian;
+    props.is_signed = opts.is_signed;
+    for (const auto &sig : signal_search::candidates(props, events.front()->size * 8, opts.min_size, opts.max_size)) {
+      auto it = signal_search::findValue(events.begin(), events.end(), sig, [&](double v) { return v == opts.value; });
+      if (it != events.end()) {
+        msg_rows << QString("%1,%2,%3,%4,%5").arg(route.name, id.toString()).arg(sig.start_bit).arg(sig.size)
+                    .arg(((*it)->mono_time - route.start_mono_time) / 1e9, 0, 'f', 2);
+      }
+    }
+    return msg_rows;
+  })) {
+    rows << r;
+  }
+  return rows;
+}
+
+static QStringList similarBits(const RouteEvents &route, const SimilarOptions &opts) {
+  QStringList rows;
+  auto src = route.events.find(opts.src);
+  if (src == route.events.end() || route.all_events.empty()) return rows;
+
+  SimilarBitsEngine engine(src->second, opts.byte_idx, opts.bit_idx, route.all_events.front()->mono_time,
+                           route.all_events.back()->mono_time, SimilarBitsEngine::DEFAULT_INTERVAL_NS);
+  std::vector<SimilarBitsEngine::Match> matches;
+  for (const auto &m : mapMessages<std::vector<SimilarBitsEngine::Match>>(route, [&](const MessageId &id, const CanEventList &events) {
+    return id.source == opts.find_bus ? engine.correlate(id.address, events, opts.equal, opts.min_msgs)
+                                      : std::vector<SimilarBitsEngine::Match>{};
+  })) {
+    matches.insert(matches.end(), m.begin(), m.end());
+  }
+  std::sort(matches.begin(), matches.end(), [](auto &l, auto &r) { return l.perc < r.perc; });
+  for (const auto &m : matches) {
+    rows << QString("%1,0x%2,%3,%4,%5,%6,%7").arg(route.name).arg(m.address, 1, 16).arg(m.byte_idx).arg(m.bit_idx)
+                .arg(m.mismatches).arg(m.total).arg(m.perc, 0, 'f', 2);
+  }
+  return rows;
+}
+
+static void exportRoute(const RouteEvents &route, const DBCFile &dbc, const QString &out_dir, bool arrow, bool raw) {
+  QDir dir(out_dir);
+  const QString route_dir = QString(route.name).replace('|', '_');
+  dir.mkpath(route_dir);
+  dir.cd(route_dir);
+
+  const double start_sec = route.start_mono_time / 1e9;
+  for (const auto &[id, events] : route.events) {
+    auto it = dbc.getMessages().find(id.address);
+    if (it != dbc.getMessages().end()) {
+      const QString file_name = dir.filePath(QString("%1_%2.%3").arg(id.source).arg(it->second.name).arg(arrow ? "arrow" : "csv"));
+      arrow ? utils::exportSignalsToArrow(file_name, it->second, events, start_sec)
+            : utils::exportSignalsToCSV(file_name, it->second, events, start_sec);
+    }
+  }
+  if (raw) {
+    utils::exportToCSV(dir.filePath("raw.csv"), route.all_events, start_sec);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Analyze CAN data of many routes without the cabana GUI.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("routes", "the routes to analyze", "route...");
+  parser.addOption({"mode", "stats, find, similar or export. default is stats", "mode", "stats"});
+  parser.addOption({"dbc", "dbc file used to decode signals", "dbc"});
+  parser.addOption({"data_dir", "local directory with routes", "data_dir"});
+  parser.addOption({"out", "output csv file, or directory in export mode. default is stdout or the current directory", "out"});
+  parser.addOption({"jobs", "number of worker threads", "n"});
+  parser.addOption({"format", "export: csv or arrow. default is csv", "format", "csv"});
+  parser.addOption({"raw", "export: also write all raw events as csv"});
+  parser.addOption({"value", "find: raw value to find", "value"});
+  parser.addOption({"size", "find: signal size range. default is 8:8", "min:max", "8:8"});
+  parser.addOption({"big-endian", "find: big endian signals"});
+  parser.addOption({"signed", "find: signed signals"});
+  parser.addOption({"source", "similar: source bit", "bus:address:byte:bit"});
+  parser.addOption({"find-bus", "similar: bus to find similar bits in", "bus", "0"});
+  parser.addOption({"not-equal", "similar: find bits that are the inverse of the source bit"});
+  parser.addOption({"min-msgs", "similar: minimum message count", "n", "100"});
+  parser.process(app);
+
+  const QStringList route_names = parser.positionalArguments();
+  const QString mode = parser.value("mode");
+  if (route_names.isEmpty() || !QStringList({"stats", "find", "similar", "export"}).contains(mode)) {
+    parser.showHelp(1);
+  }
+  if (parser.isSet("jobs")) {
+    QThreadPool::globalInstance()->setMaxThreadCount(std::max(1, parser.value("jobs").toInt()));
+  }
+
+  std::unique_ptr<DBCFile> dbc;
+  if (mode == "stats" || mode == "export") {
+    if (!parser.isSet("dbc")) {
+      qCritical() << "--dbc is required in" << mode << "mode";
+      return 1;
+    }
+    try {
+      dbc = std::make_unique<DBCFile>(parser.value("dbc"));
+    } catch (std::exception &e) {
+      qCritical() << "failed to parse dbc:" << e.what();
+      return 1;
+    }
+  }
+
+  FindOptions find_opts = {};
+  SimilarOptions similar_opts = {};
+  if (mode == "find") {
+    const QStringList size = parser.value("size").split(":");
+    find_opts = {.value = parser.value("value").toDouble(), .min_size = size.first().toInt(), .max_size = size.last().toInt(),
+                 .is_little_endian = !parser.isSet("big-endian"), .is_signed = parser.isSet("signed")};
+    find_opts.min_size = std::clamp(find_opts.min_size, 1, 64);
+    find_opts.max_size = std::clamp(find_opts.max_size, find_opts.min_size, 64);
+  } else if (mode == "similar") {
+    const QStringList src = parser.value("source").split(":");
+    if (src.size() != 4) {
+      qCritical() << "--source must be bus:address:byte:bit";
+      return 1;
+    }
+    similar_opts = {.src = {.source = (uint8_t)src[0].toUInt(), .address = src[1].toUInt(nullptr, 16)},
+                    .byte_idx = std::clamp(src[2].toInt(), 0, 63), .bit_idx = std::clamp(src[3].toInt(), 0, 7),
+                    .find_bus = (uint8_t)parser.value("find-bus").toUInt(), .equal = !parser.isSet("not-equal"),
+                    .min_msgs = parser.value("min-msgs").toUInt()};
+  }
+
+  // Routes are processed one at a time so only one route is in memory. Its segments are loaded in parallel.
+  QStringList results;
+  const QString out_dir = parser.value("out").isEmpty() ? "." : parser.value("out");
+  for (const QString &name : route_names) {
+    Route route(name, parser.value("data_dir"));
+    if (!route.load()) {
+      qWarning() << "failed to load route" << name;
+      continue;
+    }
+    std::vector<SegmentEvents> segments;
+    for (const auto &[n, files] : route.segments()) {
+      const QString &file = !files.rlog.isEmpty() ? files.rlog : files.qlog;
+      if (!file.isEmpty()) {
+        segments.push_back({.seg_num = n, .file = file});
+      }
+    }
+    QtConcurrent::blockingMap(segments, loadSegment);
+
+    RouteEvents route_events = {.name = route.name()};
+    mergeSegments(route_events, segments);
+    if (mode == "stats") {
+      results << signalStats(route_events, *dbc);
+    } else if (mode == "find") {
+      results << findSignals(route_events, find_opts);
+    } else if (mode == "similar") {
+      results << similarBits(route_events, similar_opts);
+    } else {
+      exportRoute(route_events, *dbc, out_dir, parser.value("format") == "arrow", parser.isSet("raw"));
+    }
+  }
+
+  if (mode != "export") {
+    QFile file;
+    bool opened = parser.isSet("out") ? (file.setFileName(parser.value("out")), file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                                      : file.open(stdout, QIODevice::WriteOnly);
+    if (!opened) {
+      qCritical() << "failed to open" << parser.value("out");
+      return 1;
+    }
+    QTextStream out(&file);
+    if (mode == "stats") out << "route,bus,address,message,signal,count,min,max,mean,stddev\n";
+    else if (mode == "find") out << "route,id,start_bit,size,time\n";
+    else out << "route,address,byte_idx,bit_idx,mismatches,total,perc\n";
+    for (const auto &row : results) {
+      out << row << "\n";
+    }
+  }
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "tools/cabana/binaryview.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include <QDebug>
 #include <QFontDatabase>
@@ -17,6 +18,7 @@
 
 const int CELL_HEIGHT = 36;
 const int VERTICAL_HEADER_WIDTH = 30;
+const int ALPHA_STEP = 8;
 inline int get_bit_pos(const QModelIndex &index) { return flipBitPos(index.row() * 8 + index.column()); }
 
 BinaryView::BinaryView(QWidget *parent) : QTableView(parent) {
@@ -282,7 +284,9 @@ void BinaryViewModel::refresh() {
   updateState();
 }
 
-void BinaryViewModel::updateItem(int row, int col, uint8_t val, const QColor &color) {
+void BinaryViewModel::updateItem(int row, int col, uint8_t val, QColor color) {
+  // quantize the alpha so slowly fading cells are not repainted on every update
+  color.setAlpha(std::min(std::lround(color.alphaF() * 255 / ALPHA_STEP) * ALPHA_STEP, 255L));
   auto &item = items[row * column_count + col];
   if (item.val != val || item.bg_color != color) {
     item.val = val;
@@ -1,7 +1,9 @@
 #include "tools/cabana/chart/sparkline.h"
 
 #include <algorithm>
+#include <cstring>
 #include <limits>
+#include <QApplication>
 #include <QPainter>
 
 #include "tools/cabana/streams/abstractstream.h"
@@ -10,57 +12,116 @@ void Sparkline::update(const MessageId &msg_id, const cabana::Signal *sig, doubl
   const auto &msgs = can->events(msg_id);
   uint64_t ts = (last_msg_ts + can->routeStartTime()) * 1e9;
   uint64_t first_ts = (ts > range * 1e9) ? ts - range * 1e9 : 0;
-  auto first = std::lower_bound(msgs.cbegin(), msgs.cend(), first_ts, CompareCanEvent());
-  auto last = std::upper_bound(first, msgs.cend(), ts, CompareCanEvent());
+  const qreal dpr = qApp->devicePixelRatio();
 
-  if (first == last || size.isEmpty()) {
-    pixmap = QPixmap();
+  if (size.isEmpty()) {
+    points.clear();
+    image = QImage();
+    range_ = 0;
     return;
   }
 
-  points.clear();
+  // Only the events after the last update are decoded. Start over if anything the image depends on changed,
+  // on backward seeks, if the window moved past all decoded points, or if events were merged before the last one.
+  auto first = std::upper_bound(msgs.cbegin(), msgs.cend(), last_ts, CompareCanEvent());
+  auto last = std::upper_bound(first, msgs.cend(), ts, CompareCanEvent());
+  const bool rebuild = *sig != signal || sig->color != color || range != range_ || size != size_ || dpr != dpr_ ||
+                       ts < last_ts || first_ts > last_ts || (size_t)(first - msgs.cbegin()) != last_index;
+  if (rebuild) {
+    points.clear();
+    signal = *sig;
+    color = sig->color;
+    range_ = range;
+    size_ = size;
+    dpr_ = dpr;
+    xscale = (size.width() * dpr - 1) / range;
+    first = std::lower_bound(msgs.cbegin(), last, first_ts, CompareCanEvent());
+  } else if (ts == last_ts) {
+    return;
+  }
+
+  const double prev_sec = points.empty() ? 0 : points.back().x();
   double value = 0;
   for (auto it = first; it != last; ++it) {
     if (sig->getValue((*it)->dat, (*it)->size, &value)) {
-      points.emplace_back(((*it)->mono_time - (*first)->mono_time) / 1e9, value);
+      points.emplace_back((*it)->mono_time / 1e9, value);
     }
   }
+  last_ts = ts;
+  last_index = last - msgs.cbegin();
+  while (!points.empty() && points.front().x() < first_ts / 1e9) {
+    points.pop_front();
+  }
 
   if (points.empty()) {
-    pixmap = QPixmap();
+    image = QImage();
     return;
   }
 
   const auto [min, max] = std::minmax_element(points.begin(), points.end(),
                                               [](auto &l, auto &r) { return l.y() < r.y(); });
-  min_val = min->y() == max->y() ? min->y() - 1 : min->y();
-  max_val = min->y() == max->y() ? max->y() + 1 : max->y();
-  freq_ = points.size() / std::max(points.back().x() - points.front().x(), 1.0);
-  render(sig->color, range, size);
-}
+  const double min_y = min->y() == max->y() ? min->y() - 1 : min->y();
+  const double max_y = min->y() == max->y() ? max->y() + 1 : max->y();
+  const double duration = points.back().x() - points.front().x();
+  const bool dots = duration * xscale / dpr / points.size() > 8;
+  const bool aa = points.size() < 500;
+  freq_ = points.size() / std::max(duration, 1.0);
 
-void Sparkline::render(const QColor &color, int range, QSize size) {
-  const double xscale = (size.width() - 1) / (double)range;
-  const double yscale = (size.height() - 3) / (max_val - min_val);
-  for (auto &v : points) {
-    v = QPoint(v.x() * xscale, 1 + std::abs(v.y() - max_val) * yscale);
+  const int64_t end_col = column(ts / 1e9);
+  const int64_t shift = end_col - last_col;
+  last_col = end_col;
+  if (rebuild || image.isNull() || shift >= image.width() || min_y != min_val || max_y != max_val ||
+      dots != draw_dots || aa != antialiasing) {
+    min_val = min_y;
+    max_val = max_y;
+    draw_dots = dots;
+    antialiasing = aa;
+    image = QImage(size * dpr, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(dpr);
+    render(0);
+    return;
   }
 
-  qreal dpr = qApp->devicePixelRatio();
-  size *= dpr;
-  if (size != pixmap.size()) {
-    pixmap = QPixmap(size);
+  // scroll the existing columns to the left, then redraw from the previous last point to the right edge.
+  if (shift > 0) {
+    const int width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+      uint32_t *line = (uint32_t *)image.scanLine(y);
+      memmove(line, line + shift, (width - shift) * sizeof(uint32_t));
+    }
   }
-  pixmap.setDevicePixelRatio(dpr);
-  pixmap.fill(Qt::transparent);
-  QPainter painter(&pixmap);
-  painter.setRenderHint(QPainter::Antialiasing, points.size() < 500);
+  const int margin = std::ceil(3 * dpr);  // covers the highlighted last point
+  render(std::max<int>(0, column(prev_sec) - end_col + image.width() - 1 - margin));
+}
+
+// Clears the image from device pixel column first_col to the right edge and draws the points there.
+void Sparkline::render(int first_col) {
+  const int width = image.width();
+  const double yscale = (size_.height() - 3) / (max_val - min_val);
+  auto x = [&](const QPointF &p) { return column(p.x()) - last_col + width - 1; };
+
+  // start at the last point left of the cleared area so the segment crossing into it is drawn too
+  auto begin = std::lower_bound(points.begin(), points.end(), first_col, [&](auto &p, int col) { return x(p) < col; });
+  if (begin != points.begin()) --begin;
+  std::vector<QPointF> pts;
+  pts.reserve(points.end() - begin);
+  for (auto it = begin; it != points.end(); ++it) {
+    pts.emplace_back(x(*it) / dpr_, 1 + std::abs(it->y() - max_val) * yscale);
+  }
+
+  QPainter painter(&image);
+  QRectF rect(first_col / dpr_, 0, size_.width() - first_col / dpr_, size_.height());
+  painter.setClipRect(rect);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.fillRect(rect, Qt::transparent);
+  painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+  painter.setRenderHint(QPainter::Antialiasing, antialiasing);
   painter.setPen(color);
-  painter.drawPolyline(points.data(), points.size());
+  painter.drawPolyline(pts.data(), pts.size());
   painter.setPen(QPen(color, 3));
-  if ((points.back().x() - points.front().x()) / points.size() > 8) {
-    painter.drawPoints(points.data(), points.size());
+  if (draw_dots) {
+    painter.drawPoints(pts.data(), pts.size());
   } else {
-    painter.drawPoint(points.back());
+    painter.drawPoint(pts.back());
   }
 }
@@ -1,8 +1,9 @@
 #pragma once
 
-#include <QPixmap>
+#include <QImage>
 #include <QPointF>
-#include <vector>
+#include <cmath>
+#include <deque>
 
 #include "tools/cabana/dbc/dbc.h"
 
@@ -10,15 +11,30 @@ class Sparkline {
 public:
   void update(const MessageId &msg_id, const cabana::Signal *sig, double last_msg_ts, int range, QSize size);
   inline double freq() const { return freq_; }
-  bool isEmpty() const { return pixmap.isNull(); }
+  bool isEmpty() const { return image.isNull(); }
 
-  QPixmap pixmap;
+  QImage image;
   double min_val = 0;
   double max_val = 0;
 
 private:
-  void render(const QColor &color, int range, QSize size);
+  void render(int first_col);
+  int64_t column(double sec) const { return std::floor(sec * xscale); }
 
-  std::vector<QPointF> points;
+  // decoded points in the time range, (seconds since boot, value)
+  std::deque<QPointF> points;
+  uint64_t last_ts = 0;
+  size_t last_index = 0;
+  int64_t last_col = 0;  // device pixel column of the right edge
+  bool draw_dots = false;
+  bool antialiasing = false;
+  double xscale = 0;  // device pixels per second
   double freq_ = 0;
+
+  // the state the image was rendered with, any change triggers a full rebuild
+  cabana::Signal signal;
+  QColor color;
+  int range_ = 0;
+  QSize size_;
+  qreal dpr_ = 0;
 };
@@ -1,10 +1,22 @@
 #include "tools/cabana/dbc/dbcfile.h"
 
+#include <cctype>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
-#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
 
-DBCFile::DBCFile(const QString &dbc_file_name) {
+// Bump when the parser or the cache layout changes
+const quint32 CACHE_VERSION = 1;
+
+DBCFile::DBCFile(const QString &dbc_file_name, bool use_cache) {
   QFile file(dbc_file_name);
   if (file.open(QIODevice::ReadOnly)) {
     name_ = QFileInfo(dbc_file_name).baseName();
@@ -13,7 +25,16 @@ DBCFile::DBCFile(const QString &dbc_file_name) {
     if (dbc_file_name.endsWith(AUTO_SAVE_EXTENSION)) {
       filename.chop(AUTO_SAVE_EXTENSION.length());
     }
-    parse(file.readAll());
+    const QByteArray content = file.readAll();
+    const QString cache_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString cache_file;
+    if (use_cache && !cache_dir.isEmpty()) {
+      cache_file = QString("%1/dbc/%2").arg(cache_dir, QString(QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex()));
+    }
+    if (cache_file.isEmpty() || !loadCache(cache_file)) {
+      parse(content);
+      if (!cache_file.isEmpty()) saveCache(cache_file);
+    }
   } else {
     throw std::runtime_error("Failed to open file.");
   }
@@ -21,7 +42,7 @@ DBCFile::DBCFile(const QString &dbc_file_name) {
 
 DBCFile::DBCFile(const QString &name, const QString &content) : name_(name), filename("") {
   // Open from clipboard
-  parse(content);
+  parse(content.toUtf8());
 }
 
 bool DBCFile::save() {
@@ -80,45 +101,130 @@ cabana::Signal *DBCFile::signal(uint32_t address, const QString name) {
   return m ? (cabana::Signal *)m->sig(name) : nullptr;
 }
 
-void DBCFile::parse(const QString &content) {
+// Single pass tokenizer over the UTF-8 content of a DBC file. Whitespace is skipped
+// within a line, only quoted strings can span multiple lines.
+class DBCFile::Tokenizer {
+public:
+  Tokenizer(const QByteArray &content) : p(content.constData()), end(content.constData() + content.size()) {}
+  inline bool atEnd() const { return p >= end; }
+  inline const char *pos() const { return p; }
+  inline int lineNum() const { return line_num; }
+
+  void skipSpaces() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+  }
+  bool consume(char c) {
+    skipSpaces();
+    return p < end && *p == c ? (++p, true) : false;
+  }
+  std::string_view take(bool (*pred)(char)) {
+    skipSpaces();
+    const char *start = p;
+    while (p < end && pred(*p)) ++p;
+    return {start, size_t(p - start)};
+  }
+  std::string_view identifier() {
+    return take([](char c) { return std::isalnum((unsigned char)c) || c == '_' || (c & 0x80); });
+  }
+  std::string_view number() {
+    return take([](char c) { return std::isdigit((unsigned char)c) || c == '.' || c == '+' || c == '-' || c == 'e' || c == 'E'; });
+  }
+  // Consumes the keyword if it is the next identifier
+  bool keyword(std::string_view kw) {
+    const char *start = p;
+    if (identifier() == kw && (p == end || std::isspace((unsigned char)*p))) return true;
+    p = start;
+    return false;
+  }
+  // Quoted string. Escaped quotes are unescaped if unescape is true.
+  std::optional<QString> string(bool unescape) {
+    if (!consume('"')) return std::nullopt;
+    const char *start = p;
+    bool escaped = false;
+    for (; p < end && *p != '"'; ++p) {
+      if (*p == '\n') {
+        ++line_num;
+      } else if (unescape && *p == '\\' && p + 1 < end) {
+        escaped |= p[1] == '"';
+        line_num += p[1] == '\n';
+        ++p;
+      }
+    }
+    if (p == end) return std::nullopt;
+    QString str = QString::fromUtf8(start, p++ - start);
+    return escaped ? str.replace("\\\"", "\"") : str;
+  }
+  std::string_view restOfLine() {
+    skipSpaces();
+    const char *start = p;
+    p = (const char *)memchr(p, '\n', end - p);
+    if (!p) p = end;
+    const char *last = p;
+    while (last > start && std::isspace((unsigned char)last[-1])) --last;
+    return {start, size_t(last - start)};
+  }
+  void nextLine() {
+    restOfLine();
+    if (p < end) {
+      ++p;
+      ++line_num;
+    }
+  }
+
+private:
+  const char *p, *end;
+  int line_num = 1;
+};
+
+static inline QString toQString(std::string_view s) { return QString::fromUtf8(s.data(), s.size()); }
+static inline QByteArray toBytes(std::string_view s) { return QByteArray::fromRawData(s.data(), s.size()); }
+
+void DBCFile::parse(const QByteArray &content) {
   msgs.clear();
 
-  int line_num = 0;
-  QString line;
+  Tokenizer tok(content);
   cabana::Msg *current_msg = nullptr;
   int multiplexor_cnt = 0;
   bool seen_first = false;
-  QTextStream stream((QString *)&content);
 
-  while (!stream.atEnd()) {
-    ++line_num;
-    QString raw_line = stream.readLine();
-    line = raw_line.trimmed();
+  while (!tok.atEnd()) {
+    const char *line_start = tok.pos();
+    const int line_num = tok.lineNum();
 
     bool seen = true;
     try {
-      if (line.startsWith("BO_ ")) {
+      if (tok.keyword("BO_")) {
         multiplexor_cnt = 0;
-        current_msg = parseBO(line);
-      } else if (line.startsWith("SG_ ")) {
-        parseSG(line, current_msg, multiplexor_cnt);
-      } else if (line.startsWith("VAL_ ")) {
-        parseVAL(line);
-      } else if (line.startsWith("CM_ BO_")) {
-        parseCM_BO(line, content, raw_line, stream);
-      } else if (line.startsWith("CM_ SG_ ")) {
-        parseCM_SG(line, content, raw_line, stream);
+        current_msg = parseBO(tok);
+      } else if (tok.keyword("SG_")) {
+        parseSG(tok, current_msg, multiplexor_cnt);
+      } else if (tok.keyword("VAL_")) {
+        parseVAL(tok);
+      } else if (tok.keyword("CM_")) {
+        if (tok.keyword("BO_")) {
+          parseCM_BO(tok);
+        } else if (tok.keyword("SG_")) {
+          parseCM_SG(tok);
+        } else {
+          seen = false;
+        }
       } else {
         seen = false;
       }
     } catch (std::exception &e) {
+      const int line_offset = line_start - content.constData();
+      QString line = QString::fromUtf8(content.mid(line_offset, content.indexOf('\n', line_offset) - line_offset)).trimmed();
       throw std::runtime_error(QString("[%1:%2]%3: %4").arg(filename).arg(line_num).arg(e.what()).arg(line).toStdString());
     }
 
+    tok.nextLine();
     if (seen) {
       seen_first = true;
     } else if (!seen_first) {
-      header += raw_line + "\n";
+      QByteArray raw_line(line_start, tok.pos() - line_start);
+      if (raw_line.endsWith('\n')) raw_line.chop(1);
+      if (raw_line.endsWith('\r')) raw_line.chop(1);
+      header += QString::fromUtf8(raw_line) + "\n";
     }
   }
 
@@ -127,125 +233,188 @@ void DBCFile::parse(const QString &content) {
   }
 }
 
-cabana::Msg *DBCFile::parseBO(const QString &line) {
-  static QRegularExpression bo_regexp(R"(^BO_ (?<address>\w+) (?<name>\w+) *: (?<size>\w+) (?<transmitter>\w+))");
-
-  QRegularExpressionMatch match = bo_regexp.match(line);
-  if (!match.hasMatch())
+cabana::Msg *DBCFile::parseBO(Tokenizer &tok) {
+  auto address = tok.identifier();
+  auto name = tok.identifier();
+  bool has_colon = tok.consume(':');
+  auto size = tok.identifier();
+  auto transmitter = tok.identifier();
+  if (address.empty() || name.empty() || !has_colon || size.empty() || transmitter.empty())
     throw std::runtime_error("Invalid BO_ line format");
 
-  uint32_t address = match.captured("address").toUInt();
-  if (msgs.count(address) > 0)
-    throw std::runtime_error(QString("Duplicate message address: %1").arg(address).toStdString());
+  uint32_t addr = toBytes(address).toUInt();
+  if (msgs.count(addr) > 0)
+    throw std::runtime_error(QString("Duplicate message address: %1").arg(addr).toStdString());
 
   // Create a new message object
-  cabana::Msg *msg = &msgs[address];
-  msg->address = address;
-  msg->name = match.captured("name");
-  msg->size = match.captured("size").toULong();
-  msg->transmitter = match.captured("transmitter").trimmed();
+  cabana::Msg *msg = &msgs[addr];
+  msg->address = addr;
+  msg->name = toQString(name);
+  msg->size = toBytes(size).toULong();
+  msg->transmitter = toQString(transmitter);
   return msg;
 }
 
-void DBCFile::parseCM_BO(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream) {
-  static QRegularExpression msg_comment_regexp(R"(^CM_ BO_ *(?<address>\w+) *\"(?<comment>(?:[^"\\]|\\.)*)\"\s*;)");
-
-  QString parse_line = line;
-  if (!parse_line.endsWith("\";")) {
-    int pos = stream.pos() - raw_line.length() - 1;
-    parse_line = content.mid(pos, content.indexOf("\";", pos));
-  }
-  auto match = msg_comment_regexp.match(parse_line);
-  if (!match.hasMatch())
+void DBCFile::parseCM_BO(Tokenizer &tok) {
+  auto address = tok.identifier();
+  auto comment = tok.string(true);
+  if (address.empty() || !comment)
     throw std::runtime_error("Invalid message comment format");
 
-  if (auto m = (cabana::Msg *)msg(match.captured("address").toUInt()))
-    m->comment = match.captured("comment").trimmed().replace("\\\"", "\"");
+  if (auto m = (cabana::Msg *)msg(toBytes(address).toUInt()))
+    m->comment = comment->trimmed();
 }
 
-void DBCFile::parseSG(const QString &line, cabana::Msg *current_msg, int &multiplexor_cnt) {
-  static QRegularExpression sg_regexp(R"(^SG_ (\w+) : (\d+)\|(\d+)@(\d+)([\+|\-]) \(([0-9.+\-eE]+),([0-9.+\-eE]+)\) \[([0-9.+\-eE]+)\|([0-9.+\-eE]+)\] \"(.*)\" (.*))");
-  static QRegularExpression sgm_regexp(R"(^SG_ (\w+) (\w+) *: (\d+)\|(\d+)@(\d+)([\+|\-]) \(([0-9.+\-eE]+),([0-9.+\-eE]+)\) \[([0-9.+\-eE]+)\|([0-9.+\-eE]+)\] \"(.*)\" (.*))");
-
+void DBCFile::parseSG(Tokenizer &tok, cabana::Msg *current_msg, int &multiplexor_cnt) {
   if (!current_msg)
     throw std::runtime_error("No Message");
 
-  int offset = 0;
-  auto match = sg_regexp.match(line);
-  if (!match.hasMatch()) {
-    match = sgm_regexp.match(line);
-    offset = 1;
-  }
-  if (!match.hasMatch())
+  auto name = tok.identifier();
+  auto indicator = tok.identifier();
+  bool ok = !name.empty() && tok.consume(':');
+  auto start_bit = tok.number();
+  ok &= tok.consume('|');
+  auto size = tok.number();
+  ok &= tok.consume('@');
+  auto endian = tok.take([](char c) { return c == '0' || c == '1'; });
+  auto sign = tok.take([](char c) { return c == '+' || c == '-'; });
+  ok &= tok.consume('(');
+  auto factor = tok.number();
+  ok &= tok.consume(',');
+  auto offset = tok.number();
+  ok &= tok.consume(')') && tok.consume('[');
+  auto min = tok.number();
+  ok &= tok.consume('|');
+  auto max = tok.number();
+  ok &= tok.consume(']');
+  auto unit = tok.string(false);
+  auto receiver = tok.restOfLine();
+  if (!ok || start_bit.empty() || size.empty() || endian.size() != 1 || sign.size() != 1 || factor.empty() ||
+      offset.empty() || min.empty() || max.empty() || !unit || receiver.empty())
     throw std::runtime_error("Invalid SG_ line format");
 
-  QString name = match.captured(1);
-  if (current_msg->sig(name) != nullptr)
+  QString sig_name = toQString(name);
+  if (current_msg->sig(sig_name) != nullptr)
     throw std::runtime_error("Duplicate signal name");
 
   cabana::Signal s{};
-  if (offset == 1) {
-    auto indicator = match.captured(2);
-    if (indicator == "M") {
-      ++multiplexor_cnt;
-      // Only one signal within a single message can be the multiplexer switch.
-      if (multiplexor_cnt >= 2)
-        throw std::runtime_error("Multiple multiplexor");
-
-      s.type = cabana::Signal::Type::Multiplexor;
-    } else {
-      s.type = cabana::Signal::Type::Multiplexed;
-      s.multiplex_value = indicator.mid(1).toInt();
-    }
+  if (indicator == "M") {
+    ++multiplexor_cnt;
+    // Only one signal within a single message can be the multiplexer switch.
+    if (multiplexor_cnt >= 2)
+      throw std::runtime_error("Multiple multiplexor");
+
+    s.type = cabana::Signal::Type::Multiplexor;
+  } else if (!indicator.empty()) {
+    s.type = cabana::Signal::Type::Multiplexed;
+    s.multiplex_value = toBytes(indicator.substr(1)).toInt();
   }
-  s.name = name;
-  s.start_bit = match.captured(offset + 2).toInt();
-  s.size = match.captured(offset + 3).toInt();
-  s.is_little_endian = match.captured(offset + 4).toInt() == 1;
-  s.is_signed = match.captured(offset + 5) == "-";
-  s.factor = match.captured(offset + 6).toDouble();
-  s.offset = match.captured(offset + 7).toDouble();
-  s.min = match.captured(8 + offset).toDouble();
-  s.max = match.captured(9 + offset).toDouble();
-  s.unit = match.captured(10 + offset);
-  s.receiver_name = match.captured(11 + offset).trimmed();
+  s.name = sig_name;
+  s.start_bit = toBytes(start_bit).toInt();
+  s.size = toBytes(size).toInt();
+  s.is_little_endian = endian == "1";
+  s.is_signed = sign == "-";
+  s.factor = toBytes(factor).toDouble();
+  s.offset = toBytes(offset).toDouble();
+  s.min = toBytes(min).toDouble();
+  s.max = toBytes(max).toDouble();
+  s.unit = *unit;
+  s.receiver_name = toQString(receiver);
   current_msg->sigs.push_back(new cabana::Signal(s));
 }
 
-void DBCFile::parseCM_SG(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream) {
-  static QRegularExpression sg_comment_regexp(R"(^CM_ SG_ *(\w+) *(\w+) *\"((?:[^"\\]|\\.)*)\"\s*;)");
+void DBCFile::parseCM_SG(Tokenizer &tok) {
+  auto address = tok.identifier();
+  auto name = tok.identifier();
+  auto comment = tok.string(true);
+  if (address.empty() || name.empty() || !comment)
+    throw std::runtime_error("Invalid CM_ SG_ line format");
 
-  QString parse_line = line;
-  if (!parse_line.endsWith("\";")) {
-    int pos = stream.pos() - raw_line.length() - 1;
-    parse_line = content.mid(pos, content.indexOf("\";", pos));
+  if (auto s = signal(toBytes(address).toUInt(), toQString(name))) {
+    s->comment = comment->trimmed();
   }
-  auto match = sg_comment_regexp.match(parse_line);
-  if (!match.hasMatch())
-    throw std::runtime_error("Invalid CM_ SG_ line format");
+}
 
-  if (auto s = signal(match.captured(1).toUInt(), match.captured(2))) {
-    s->comment = match.captured(3).trimmed().replace("\\\"", "\"");
+void DBCFile::parseVAL(Tokenizer &tok) {
+  auto address = tok.identifier();
+  auto name = tok.identifier();
+  ValueDescription val_desc;
+  for (auto val = tok.number(); !val.empty(); val = tok.number()) {
+    auto desc = tok.string(false);
+    if (!desc)
+      throw std::runtime_error("invalid VAL_ line format");
+    val_desc.push_back({toBytes(val).toDouble(), desc->trimmed()});
+  }
+  if (address.empty() || name.empty() || val_desc.empty())
+    throw std::runtime_error("invalid VAL_ line format");
+
+  if (auto s = signal(toBytes(address).toUInt(), toQString(name))) {
+    s->val_desc.insert(s->val_desc.end(), val_desc.begin(), val_desc.end());
   }
 }
 
-void DBCFile::parseVAL(const QString &line) {
-  static QRegularExpression val_regexp(R"(VAL_ (\w+) (\w+) (\s*[-+]?[0-9]+\s+\".+?\"[^;]*))");
+bool DBCFile::loadCache(const QString &cache_file) {
+  QFile file(cache_file);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_12);
+  quint32 version = 0, msg_count = 0;
+  in >> version;
+  if (version != CACHE_VERSION) return false;
+
+  in >> header >> msg_count;
+  for (quint32 i = 0; i < msg_count && in.status() == QDataStream::Ok; ++i) {
+    uint32_t address = 0;
+    quint32 sig_count = 0;
+    in >> address;
+    cabana::Msg &m = msgs[address];
+    m.address = address;
+    in >> m.name >> m.size >> m.comment >> m.transmitter >> sig_count;
+    for (quint32 j = 0; j < sig_count && in.status() == QDataStream::Ok; ++j) {
+      auto s = m.sigs.emplace_back(new cabana::Signal);
+      qint32 type = 0;
+      quint32 val_count = 0;
+      in >> type >> s->name >> s->start_bit >> s->size >> s->is_little_endian >> s->is_signed >> s->factor >> s->offset >>
+          s->min >> s->max >> s->unit >> s->comment >> s->receiver_name >> s->multiplex_value >> val_count;
+      s->type = (cabana::Signal::Type)type;
+      for (quint32 k = 0; k < val_count && in.status() == QDataStream::Ok; ++k) {
+        auto &[val, desc] = s->val_desc.emplace_back();
+        in >> val >> desc;
+      }
+    }
+  }
 
-  auto match = val_regexp.match(line);
-  if (!match.hasMatch())
-    throw std::runtime_error("invalid VAL_ line format");
+  if (in.status() != QDataStream::Ok) {
+    msgs.clear();
+    header.clear();
+    return false;
+  }
+  for (auto &[_, m] : msgs) {
+    m.update();
+  }
+  return true;
+}
 
-  if (auto s = signal(match.captured(1).toUInt(), match.captured(2))) {
-    QStringList desc_list = match.captured(3).trimmed().split('"');
-    for (int i = 0; i < desc_list.size(); i += 2) {
-      auto val = desc_list[i].trimmed();
-      if (!val.isEmpty() && (i + 1) < desc_list.size()) {
-        auto desc = desc_list[i + 1].trimmed();
-        s->val_desc.push_back({val.toDouble(), desc});
+void DBCFile::saveCache(const QString &cache_file) const {
+  QDir().mkpath(QFileInfo(cache_file).path());
+  QSaveFile file(cache_file);
+  if (!file.open(QIODevice::WriteOnly)) return;
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_12);
+  out << CACHE_VERSION << header << (quint32)msgs.size();
+  for (const auto &[address, m] : msgs) {
+    out << address << m.name << m.size << m.comment << m.transmitter << (quint32)m.sigs.size();
+    for (auto s : m.sigs) {
+      out << (qint32)s->type << s->name << s->start_bit << s->size << s->is_little_endian << s->is_signed << s->factor << s->offset
+          << s->min << s->max << s->unit << s->comment << s->receiver_name << s->multiplex_value << (quint32)s->val_desc.size();
+      for (auto &[val, desc] : s->val_desc) {
+        out << val << desc;
       }
     }
   }
+  file.commit();
 }
 
 QString DBCFile::generateDBC() {
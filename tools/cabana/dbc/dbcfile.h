@@ -1,7 +1,6 @@
 #pragma once
 
 #include <map>
-#include <QTextStream>
 
 #include "tools/cabana/dbc/dbc.h"
 
@@ -9,7 +8,8 @@ const QString AUTO_SAVE_EXTENSION = ".tmp";
 
 class DBCFile {
 public:
-  DBCFile(const QString &dbc_file_name);
+  // Parsed files are cached on disk, keyed by the hash of their content.
+  DBCFile(const QString &dbc_file_name, bool use_cache = true);
   DBCFile(const QString &name, const QString &content);
   ~DBCFile() {}
 
@@ -35,12 +35,15 @@ public:
   QString filename;
 
 private:
-  void parse(const QString &content);
-  cabana::Msg *parseBO(const QString &line);
-  void parseSG(const QString &line, cabana::Msg *current_msg, int &multiplexor_cnt);
-  void parseCM_BO(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream);
-  void parseCM_SG(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream);
-  void parseVAL(const QString &line);
+  class Tokenizer;
+  void parse(const QByteArray &content);
+  cabana::Msg *parseBO(Tokenizer &tok);
+  void parseSG(Tokenizer &tok, cabana::Msg *current_msg, int &multiplexor_cnt);
+  void parseCM_BO(Tokenizer &tok);
+  void parseCM_SG(Tokenizer &tok);
+  void parseVAL(Tokenizer &tok);
+  bool loadCache(const QString &cache_file);
+  void saveCache(const QString &cache_file) const;
 
   QString header;
   std::map<uint32_t, cabana::Msg> msgs;
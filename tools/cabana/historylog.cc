@@ -1,27 +1,64 @@
 #include "tools/cabana/historylog.h"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 
 #include <QFileDialog>
 #include <QPainter>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 
 #include "tools/cabana/commands.h"
-#include "tools/cabana/utils/export.h"
+#include "tools/cabana/utils/streamexport.h"
+
+namespace {
+
+const size_t SCAN_CHUNK_SIZE = 4096;
+// More new events than this restart the background scan
+const size_t MAX_HEAD_EVENTS = 10000;
+const size_t MAX_COLORED_ROWS = 1000;
+
+inline bool matchFilter(const cabana::Signal *sig, const std::function<bool(double, double)> &cmp, double filter_value, const CanEvent *e) {
+  double value = 0;
+  return !cmp || (sig->getValue(e->dat, e->size, &value) && cmp(value, filter_value));
+}
+
+}  // namespace
+
+HistoryLogModel::HistoryLogModel(QObject *parent) : QAbstractTableModel(parent) {
+  scan_watcher = new QFutureWatcher<ScanResult>(this);
+  QObject::connect(scan_watcher, &QFutureWatcher<ScanResult>::resultReadyAt, this, &HistoryLogModel::scanResultsReady);
+  // The scan reads events owned by the stream, stop it before the stream is deleted
+  QObject::connect(StreamNotifier::instance(), &StreamNotifier::changingStream, this, [this]() {
+    cancelScan();
+    scan_watcher->waitForFinished();
+  });
+}
+
+HistoryLogModel::~HistoryLogModel() {
+  cancelScan();
+}
 
 QVariant HistoryLogModel::data(const QModelIndex &index, int role) const {
-  const auto &m = messages[index.row()];
+  const CanEvent *e = rows[index.row()];
   const int col = index.column();
   if (role == Qt::DisplayRole) {
-    if (col == 0) return QString::number((m.mono_time / (double)1e9) - can->routeStartTime(), 'f', 3);
-    if (!isHexMode()) return sigs[col - 1]->formatValue(m.sig_values[col - 1], false);
+    if (col == 0) return QString::number((e->mono_time / (double)1e9) - can->routeStartTime(), 'f', 3);
+    double value = 0;
+    if (!isHexMode() && sigs[col - 1]->getValue(e->dat, e->size, &value)) return sigs[col - 1]->formatValue(value, false);
   } else if (role == Qt::TextAlignmentRole) {
     return (uint32_t)(Qt::AlignRight | Qt::AlignVCenter);
   }
 
   if (isHexMode() && col == 1) {
-    if (role == ColorsRole) return QVariant::fromValue((void *)(&m.colors));
-    if (role == BytesRole) return QVariant::fromValue((void *)(&m.data));
+    if (role == ColorsRole) {
+      static const std::vector<QColor> no_colors;
+      return QVariant::fromValue((void *)(index.row() < colors.size() ? &colors[index.row()] : &no_colors));
+    }
+    if (role == BytesRole) {
+      return QByteArray((const char *)e->dat, e->size);
+    }
   }
   return {};
 }
@@ -32,12 +69,14 @@ void HistoryLogModel::setMessage(const MessageId &message_id) {
 }
 
 void HistoryLogModel::reset() {
+  cancelScan();
   beginResetModel();
   sigs.clear();
   if (auto dbc_msg = dbc()->msg(msg_id)) {
     sigs = dbc_msg->getSignals();
   }
-  messages.clear();
+  rows.clear();
+  colors.clear();
   hex_colors = {};
   endResetModel();
   setFilter(0, "", nullptr);
@@ -70,65 +109,124 @@ void HistoryLogModel::setHexMode(bool hex) {
 void HistoryLogModel::setFilter(int sig_idx, const QString &value, std::function<bool(double, double)> cmp) {
   filter_sig_idx = sig_idx;
   filter_value = value.toDouble();
-  filter_cmp = value.isEmpty() ? nullptr : cmp;
+  filter_cmp = value.isEmpty() || sig_idx < 0 || sig_idx >= sigs.size() ? nullptr : cmp;
   updateState(true);
 }
 
 void HistoryLogModel::updateState(bool clear) {
-  if (clear && !messages.empty()) {
-    beginRemoveRows({}, 0, messages.size() - 1);
-    messages.clear();
-    endRemoveRows();
+  const uint64_t current_time = (can->lastMessage(msg_id).ts + can->routeStartTime()) * 1e9 + 1;
+  const auto &events = can->events(msg_id);
+  auto first = std::lower_bound(events.begin(), events.end(), head_time, CompareCanEvent());
+  auto last = std::lower_bound(first, events.end(), current_time, CompareCanEvent());
+  if (clear || current_time < head_time || (size_t)(last - first) > MAX_HEAD_EVENTS) {
+    if (!rows.empty()) {
+      beginRemoveRows({}, 0, rows.size() - 1);
+      rows.clear();
+      endRemoveRows();
+    }
+    colors.clear();
+    hex_colors = {};
+    head_time = current_time;
+    startScan();
+    return;
+  }
+
+  // Add the events received since the last update
+  Matches new_rows;
+  for (auto it = last; it != first;) {
+    const CanEvent *e = *(--it);
+    if (matchFilter(filter_cmp ? sigs[filter_sig_idx] : nullptr, filter_cmp, filter_value, e)) {
+      new_rows.push_back(e);
+    }
+  }
+  head_time = current_time;
+  if (!new_rows.empty()) {
+    beginInsertRows({}, 0, new_rows.size() - 1);
+    rows.insert(rows.begin(), new_rows.begin(), new_rows.end());
+    if (isHexMode()) {
+      colors.insert(colors.begin(), new_rows.size(), {});
+      computeColors(0, new_rows.size());
+    }
+    endInsertRows();
   }
-  uint64_t current_time = (can->lastMessage(msg_id).ts + can->routeStartTime()) * 1e9 + 1;
-  fetchData(messages.begin(), current_time, messages.empty() ? 0 : messages.front().mono_time);
 }
 
-bool HistoryLogModel::canFetchMore(const QModelIndex &parent) const {
-  const auto &events = can->events(msg_id);
-  return !events.empty() && !messages.empty() && messages.back().mono_time > events.front()->mono_time;
+void HistoryLogModel::startScan() {
+  cancelScan();
+  next_chunk = 0;
+
+  // The scan works on copies, the event list and the DBC may change while it is running.
+  const CanEventList events = can->events(msg_id);
+  std::shared_ptr<const cabana::Msg> msg;
+  if (auto dbc_msg = dbc()->msg(msg_id); dbc_msg && filter_cmp) {
+    msg = std::make_shared<const cabana::Msg>(*dbc_msg);
+  }
+  const size_t end = std::lower_bound(events.begin(), events.end(), head_time, CompareCanEvent()) - events.begin();
+  std::vector<std::pair<size_t, size_t>> chunks;  // newest first
+  for (size_t last = end; last > 0; last -= std::min(last, SCAN_CHUNK_SIZE)) {
+    chunks.push_back({last - std::min(last, SCAN_CHUNK_SIZE), last});
+  }
+
+  const size_t colored_rows = isHexMode() ? batch_size : 0;
+  std::function<ScanResult(const std::pair<size_t, size_t> &)> scan =
+      [events, msg, sig_idx = filter_sig_idx, cmp = msg ? filter_cmp : nullptr, value = filter_value, colored_rows,
+       id = msg_id, freq = can->lastMessage(msg_id).freq, speed = can->getSpeed()](const std::pair<size_t, size_t> &chunk) {
+        ScanResult result;
+        for (auto it = events.begin() + chunk.second, first = events.begin() + chunk.first; it != first;) {
+          const CanEvent *e = *(--it);
+          if (matchFilter(msg ? msg->sigs[sig_idx] : nullptr, cmp, value, e)) {
+            result.matches.push_back(e);
+          }
+        }
+        // The colors depend on the previous rows, compute them in time order
+        const std::vector<uint8_t> no_mask;
+        result.colors.resize(std::min(result.matches.size(), colored_rows));
+        for (int i = (int)result.colors.size() - 1; i >= 0; --i) {
+          const CanEvent *e = result.matches[i];
+          result.hex_colors.compute(id, e->dat, e->size, e->mono_time / (double)1e9, speed, no_mask, freq);
+          result.colors[i] = result.hex_colors.colors;
+        }
+        return result;
+      };
+  scan_watcher->setFuture(QtConcurrent::mapped(chunks, scan));
 }
 
-void HistoryLogModel::fetchMore(const QModelIndex &parent) {
-  if (!messages.empty())
-    fetchData(messages.end(), messages.back().mono_time, 0);
+void HistoryLogModel::cancelScan() {
+  // Running chunks only read copies and the stream's events, they are waited for when the stream changes
+  scan_watcher->cancel();
 }
 
-void HistoryLogModel::fetchData(std::deque<Message>::iterator insert_pos, uint64_t from_time, uint64_t min_time) {
-  const auto &events = can->events(msg_id);
-  auto first = std::upper_bound(events.rbegin(), events.rend(), from_time, [](uint64_t ts, auto e) {
-    return ts > e->mono_time;
-  });
+void HistoryLogModel::scanResultsReady() {
+  // Chunks may finish out of order, append them newest first
+  const QFuture<ScanResult> future = scan_watcher->future();
+  while (future.isResultReadyAt(next_chunk)) {
+    const ScanResult result = future.resultAt(next_chunk++);
+    const Matches &matches = result.matches;
+    if (matches.empty()) continue;
 
-  std::vector<HistoryLogModel::Message> msgs;
-  std::vector<double> values(sigs.size());
-  msgs.reserve(batch_size);
-  for (; first != events.rend() && (*first)->mono_time > min_time; ++first) {
-    const CanEvent *e = *first;
-    for (int i = 0; i < sigs.size(); ++i) {
-      sigs[i]->getValue(e->dat, e->size, &values[i]);
-    }
-    if (!filter_cmp || filter_cmp(values[filter_sig_idx], filter_value)) {
-       msgs.emplace_back(Message{e->mono_time, values, {e->dat, e->dat + e->size}});
-      if (msgs.size() >= batch_size && min_time == 0) {
-        break;
-      }
+    const int first = rows.size();
+    beginInsertRows({}, first, first + matches.size() - 1);
+    rows.insert(rows.end(), matches.begin(), matches.end());
+    if (isHexMode() && colors.size() == first && first < batch_size) {
+      const int last = std::min<int>(rows.size(), batch_size);
+      colors.insert(colors.end(), result.colors.begin(), result.colors.begin() + (last - first));
+      // Rows added later continue from the newest scanned row
+      if (first == 0) hex_colors = result.hex_colors;
     }
+    endInsertRows();
   }
+}
 
-  if (!msgs.empty()) {
-    if (isHexMode() && (min_time > 0 || messages.empty())) {
-      const auto freq = can->lastMessage(msg_id).freq;
-      const std::vector<uint8_t> no_mask;
-      for (auto &m : msgs) {
-        hex_colors.compute(msg_id, m.data.data(), m.data.size(), m.mono_time / (double)1e9, can->getSpeed(), no_mask, freq);
-        m.colors = hex_colors.colors;
-      }
-    }
-    int pos = std::distance(messages.begin(), insert_pos);
-    beginInsertRows({}, pos , pos + msgs.size() - 1);
-    messages.insert(insert_pos, std::move_iterator(msgs.begin()), std::move_iterator(msgs.end()));
-    endInsertRows();
+void HistoryLogModel::computeColors(int first, int last) {
+  const auto freq = can->lastMessage(msg_id).freq;
+  const std::vector<uint8_t> no_mask;
+  for (int i = last - 1; i >= first; --i) {
+    const CanEvent *e = rows[i];
+    hex_colors.compute(msg_id, e->dat, e->size, e->mono_time / (double)1e9, can->getSpeed(), no_mask, freq);
+    colors[i] = hex_colors.colors;
+  }
+  while (colors.size() > MAX_COLORED_ROWS) {
+    colors.pop_back();
   }
 }
 
@@ -239,10 +337,22 @@ void LogsWidget::filterChanged() {
 
 void LogsWidget::exportToCSV() {
   QString dir = QString("%1/%2_%3.csv").arg(settings.last_dir).arg(can->routeName()).arg(msgName(model->msg_id));
-  QString fn = QFileDialog::getSaveFileName(this, QString("Export %1 to CSV file").arg(msgName(model->msg_id)),
-                                            dir, tr("csv (*.csv)"));
+  const QString csv_filter = tr("csv (*.csv)"), arrow_filter = tr("arrow (*.arrow)");
+  QString selected_filter;
+  QString fn = QFileDialog::getSaveFileName(this, QString("Export %1 to CSV file").arg(msgName(model->msg_id)), dir,
+                                            model->isHexMode() ? csv_filter : csv_filter + ";;" + arrow_filter, &selected_filter);
   if (!fn.isEmpty()) {
-    model->isHexMode() ? utils::exportToCSV(fn, model->msg_id)
-                       : utils::exportSignalsToCSV(fn, model->msg_id);
+    // the format is the one picked in the dialog, a name typed without the extension gets it
+    const bool arrow = !model->isHexMode() && selected_filter == arrow_filter;
+    const QString ext = arrow ? ".arrow" : ".csv";
+    if (!fn.endsWith(ext)) fn += ext;
+
+    if (model->isHexMode()) {
+      utils::exportToCSV(fn, model->msg_id);
+    } else if (arrow) {
+      utils::exportSignalsToArrow(fn, model->msg_id);
+    } else {
+      utils::exportSignalsToCSV(fn, model->msg_id);
+    }
   }
 }
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include <QComboBox>
+#include <QFutureWatcher>
 #include <QHeaderView>
 #include <QLineEdit>
 #include <QTableView>
@@ -22,28 +23,31 @@ class HistoryLogModel : public QAbstractTableModel {
   Q_OBJECT
 
 public:
-  HistoryLogModel(QObject *parent) : QAbstractTableModel(parent) {}
+  HistoryLogModel(QObject *parent);
+  ~HistoryLogModel();
   void setMessage(const MessageId &message_id);
   void updateState(bool clear = false);
   void setFilter(int sig_idx, const QString &value, std::function<bool(double, double)> cmp);
   QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
-  void fetchMore(const QModelIndex &parent) override;
-  bool canFetchMore(const QModelIndex &parent) const override;
-  int rowCount(const QModelIndex &parent = QModelIndex()) const override { return messages.size(); }
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override { return rows.size(); }
   int columnCount(const QModelIndex &parent = QModelIndex()) const override { return !isHexMode() ? sigs.size() + 1 : 2; }
   inline bool isHexMode() const { return sigs.empty() || hex_mode; }
   void reset();
   void setHexMode(bool hex_mode);
 
-  struct Message {
-    uint64_t mono_time = 0;
-    std::vector<double> sig_values;
-    std::vector<uint8_t> data;
-    std::vector<QColor> colors;
+  typedef std::vector<const CanEvent *> Matches;
+  struct ScanResult {
+    Matches matches;  // newest first
+    // Byte colors of the newest matches in hex mode, computed from the oldest of them to the newest
+    std::vector<std::vector<QColor>> colors;
+    CanData hex_colors;
   };
 
-  void fetchData(std::deque<Message>::iterator insert_pos, uint64_t from_time, uint64_t min_time);
+  void startScan();
+  void cancelScan();
+  void scanResultsReady();
+  void computeColors(int first, int last);
 
   MessageId msg_id;
   CanData hex_colors;
@@ -51,9 +55,17 @@ public:
   int filter_sig_idx = -1;
   double filter_value = 0;
   std::function<bool(double, double)> filter_cmp = nullptr;
-  std::deque<Message> messages;
   std::vector<cabana::Signal *> sigs;
   bool hex_mode = false;
+
+  // Matching events, newest first. Rows are decoded when the view asks for them.
+  std::deque<const CanEvent *> rows;
+  // Byte colors of the newest rows in hex mode
+  std::deque<std::vector<QColor>> colors;
+  // Events before head_time are covered by the background scan, newer ones are added by updateState.
+  uint64_t head_time = 0;
+  QFutureWatcher<ScanResult> *scan_watcher;
+  int next_chunk = 0;
 };
 
 class LogsWidget : public QFrame {
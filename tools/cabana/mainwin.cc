@@ -4,14 +4,17 @@
 #include <iostream>
 #include <string>
 
+#include <QAbstractEventDispatcher>
 #include <QClipboard>
 #include <QDesktopWidget>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFontDatabase>
 #include <QJsonObject>
 #include <QMenuBar>
 #include <QMessageBox>
+#include <QPainter>
 #include <QResizeEvent>
 #include <QShortcut>
 #include <QTextDocument>
@@ -22,7 +25,7 @@
 #include "tools/cabana/commands.h"
 #include "tools/cabana/streamselector.h"
 #include "tools/cabana/tools/findsignal.h"
-#include "tools/cabana/utils/export.h"
+#include "tools/cabana/utils/streamexport.h"
 #include "tools/replay/replay.h"
 
 MainWindow::MainWindow() : QMainWindow() {
@@ -150,6 +153,9 @@ void MainWindow::createActions() {
   view_menu->addAction(video_dock->toggleViewAction());
   view_menu->addSeparator();
   view_menu->addAction(tr("Reset Window Layout"), [this]() { restoreState(default_state); });
+  auto frame_time_act = view_menu->addAction(tr("Show Frame Time"));
+  frame_time_act->setCheckable(true);
+  QObject::connect(frame_time_act, &QAction::toggled, this, &MainWindow::toggleFrameTimeOverlay);
 
   // Tools Menu
   tools_menu = menuBar()->addMenu(tr("&Tools"));
@@ -577,6 +583,17 @@ void MainWindow::updateStatus() {
   status_label->setText(tr("Cached Minutes:%1 FPS:%2").arg(settings.max_cached_minutes).arg(settings.fps));
 }
 
+bool MainWindow::event(QEvent *event) {
+  if (event->type() == QEvent::UpdateRequest && frame_time_overlay) {
+    QElapsedTimer timer;
+    timer.start();
+    bool ret = QMainWindow::event(event);
+    frame_time_overlay->addPaintTime(timer.nsecsElapsed() / 1e6);
+    return ret;
+  }
+  return QMainWindow::event(event);
+}
+
 bool MainWindow::eventFilter(QObject *obj, QEvent *event) {
   if (obj == floating_window && event->type() == QEvent::Close) {
     toggleChartsDocking();
@@ -667,6 +684,16 @@ void MainWindow::toggleFullScreen() {
   }
 }
 
+void MainWindow::toggleFrameTimeOverlay(bool show) {
+  delete frame_time_overlay;
+  frame_time_overlay = nullptr;
+  if (show) {
+    frame_time_overlay = new FrameTimeOverlay(this);
+    frame_time_overlay->show();
+    frame_time_overlay->raise();
+  }
+}
+
 // HelpOverlay
 HelpOverlay::HelpOverlay(MainWindow *parent) : QWidget(parent) {
   setAttribute(Qt::WA_NoSystemBackground, true);
@@ -713,3 +740,71 @@ bool HelpOverlay::eventFilter(QObject *obj, QEvent *event) {
 void HelpOverlay::mouseReleaseEvent(QMouseEvent *event) {
   close();
 }
+
+// FrameTimeOverlay
+
+FrameTimeOverlay::FrameTimeOverlay(MainWindow *parent) : QWidget(parent) {
+  setAttribute(Qt::WA_TransparentForMouseEvents, true);
+  setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+  // the time between waking up and blocking again is the time spent on one event loop iteration
+  auto dispatcher = QAbstractEventDispatcher::instance();
+  QObject::connect(dispatcher, &QAbstractEventDispatcher::awake, this, [this]() {
+    if (!busy_timer.isValid()) busy_timer.start();
+  });
+  QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, [this]() {
+    if (busy_timer.isValid()) {
+      double ms = busy_timer.nsecsElapsed() / 1e6;
+      busy_ms += ms;
+      max_busy_ms = std::max(max_busy_ms, ms);
+      busy_timer.invalidate();
+    }
+  });
+  parent->installEventFilter(this);
+  interval_timer.start();
+  updateStats();
+  startTimer(1000);
+}
+
+void FrameTimeOverlay::updateStats() {
+  const double interval_ms = std::max<double>(interval_timer.restart(), 1);
+  double avg = 0, max = 0;
+  for (double ms : paint_times) {
+    avg += ms / paint_times.size();
+    max = std::max(max, ms);
+  }
+  text = tr("paint: %1 fps, avg %2 ms, max %3 ms\nevent loop: %4% busy, max %5 ms")
+             .arg(paint_times.size() * 1000.0 / interval_ms, 0, 'f', 1)
+             .arg(avg, 0, 'f', 2)
+             .arg(max, 0, 'f', 2)
+             .arg(std::min(busy_ms * 100.0 / interval_ms, 100.0), 0, 'f', 1)
+             .arg(max_busy_ms, 0, 'f', 2);
+  paint_times.clear();
+  busy_ms = max_busy_ms = 0;
+  updatePosition();
+  update();
+}
+
+void FrameTimeOverlay::updatePosition() {
+  QSize size = fontMetrics().boundingRect(QRect(), Qt::AlignLeft, text).size() + QSize(16, 12);
+  auto central = ((MainWindow *)parentWidget())->centralWidget();
+  setGeometry(QRect(central->geometry().topRight() + QPoint(-size.width() - 10, 10), size));
+}
+
+void FrameTimeOverlay::paintEvent(QPaintEvent *event) {
+  QPainter painter(this);
+  painter.fillRect(rect(), QColor(0, 0, 0, 160));
+  painter.setPen(Qt::white);
+  painter.drawText(rect().adjusted(8, 6, -8, -6), Qt::AlignLeft, text);
+}
+
+void FrameTimeOverlay::timerEvent(QTimerEvent *event) {
+  updateStats();
+}
+
+bool FrameTimeOverlay::eventFilter(QObject *obj, QEvent *event) {
+  if (obj == parentWidget() && event->type() == QEvent::Resize) {
+    updatePosition();
+  }
+  return false;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QDockWidget>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QMainWindow>
 #include <QMenu>
@@ -8,6 +9,7 @@
 #include <QSplitter>
 #include <QStatusBar>
 #include <set>
+#include <vector>
 
 #include "tools/cabana/chart/chartswidget.h"
 #include "tools/cabana/dbc/dbcmanager.h"
@@ -16,6 +18,8 @@
 #include "tools/cabana/videowidget.h"
 #include "tools/cabana/tools/findsimilarbits.h"
 
+class FrameTimeOverlay;
+
 class MainWindow : public QMainWindow {
   Q_OBJECT
 
@@ -46,6 +50,7 @@ signals:
   void updateProgressBar(uint64_t cur, uint64_t total, bool success);
 
 protected:
+  bool event(QEvent *event) override;
   bool eventFilter(QObject *obj, QEvent *event) override;
   void remindSaveChanges();
   void closeFile(SourceSet s = SOURCE_ALL);
@@ -73,6 +78,7 @@ protected:
   void undoStackIndexChanged(int index);
   void onlineHelp();
   void toggleFullScreen();
+  void toggleFrameTimeOverlay(bool show);
   void updateStatus();
   void updateLoadSaveMenus();
   void createDockWidgets();
@@ -84,6 +90,7 @@ protected:
   MessagesWidget *messages_widget = nullptr;
   CenterWidget *center_widget;
   QWidget *floating_window = nullptr;
+  FrameTimeOverlay *frame_time_overlay = nullptr;
   QVBoxLayout *charts_layout;
   QProgressBar *progress_bar;
   QLabel *status_label;
@@ -117,3 +124,25 @@ protected:
   void mouseReleaseEvent(QMouseEvent *event) override;
   bool eventFilter(QObject *obj, QEvent *event) override;
 };
+
+// Shows how long the GUI thread spends per event loop iteration and per paint of the main window
+class FrameTimeOverlay : public QWidget {
+  Q_OBJECT
+public:
+  FrameTimeOverlay(MainWindow *parent);
+  void addPaintTime(double ms) { paint_times.push_back(ms); }
+
+protected:
+  void updateStats();
+  void updatePosition();
+  void paintEvent(QPaintEvent *event) override;
+  void timerEvent(QTimerEvent *event) override;
+  bool eventFilter(QObject *obj, QEvent *event) override;
+
+  QElapsedTimer interval_timer;
+  QElapsedTimer busy_timer;
+  double busy_ms = 0;
+  double max_busy_ms = 0;
+  std::vector<double> paint_times;
+  QString text;
+};
@@ -222,6 +222,8 @@ QVariant MessageListModel::data(const QModelIndex &index, int role) const {
     auto tooltip = item.name;
     if (msg && !msg->comment.isEmpty()) tooltip += "<br /><span style=\"color:gray;\">" + msg->comment + "</span>";
     return tooltip;
+  } else if (role == Qt::ToolTipRole && index.column() == Column::FREQ && item.id.source != INVALID_SOURCE) {
+    return tr("%1 Hz over the last minute").arg(can->calcFreq(item.id, can->currentSec()), 0, 'f', 2);
   }
   return {};
 }
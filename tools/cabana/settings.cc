@@ -10,7 +10,7 @@
 #include <QStandardPaths>
 #include <type_traits>
 
-#include "tools/cabana/utils/util.h"
+#include "tools/cabana/utils/widgets.h"
 
 const int MIN_CACHE_MINIUTES = 30;
 const int MAX_CACHE_MINIUTES = 120;
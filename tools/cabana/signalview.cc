@@ -343,10 +343,10 @@ void SignalItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
       painter->setPen(option.palette.color(option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text));
       painter->setFont(option.font);
       painter->drawText(r, option.displayAlignment, text);
-    } else if (index.column() == 1 && !item->sparkline.pixmap.isNull()) {
+    } else if (index.column() == 1 && !item->sparkline.isEmpty()) {
       // sparkline
-      QSize sparkline_size = item->sparkline.pixmap.size() / item->sparkline.pixmap.devicePixelRatio();
-      painter->drawPixmap(QRect(r.topLeft(), sparkline_size), item->sparkline.pixmap);
+      QSize sparkline_size = item->sparkline.image.size() / item->sparkline.image.devicePixelRatio();
+      painter->drawImage(QRect(r.topLeft(), sparkline_size), item->sparkline.image);
       // min-max value
       painter->setPen(option.palette.color(option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text));
       QRect rect = r.adjusted(sparkline_size.width() + 1, 0, 0, 0);
@@ -4,10 +4,10 @@
 #include <utility>
 
 #include <QApplication>
-#include "common/timing.h"
 #include "tools/cabana/settings.h"
 
 static const int EVENT_NEXT_BUFFER_SIZE = 6 * 1024 * 1024;  // 6MB
+static const uint64_t CHECKPOINT_INTERVAL = 30'000'000'000ULL;  // 30s
 
 AbstractStream *can = nullptr;
 
@@ -34,25 +34,33 @@ AbstractStream::AbstractStream(QObject *parent) : QObject(parent) {
 }
 
 void AbstractStream::updateMasks() {
-  std::lock_guard lk(mutex_);
-  masks_.clear();
-  if (!settings.suppress_defined_signals)
-    return;
-
-  for (const auto s : sources) {
-    for (const auto &[address, m] : dbc()->getMessages(s)) {
-      masks_[{.source = (uint8_t)s, .address = address}] = m.mask;
-    }
-  }
-  // clear bit change counts
-  for (auto &[id, m] : messages_) {
-    auto &mask = masks_[id];
-    const int size = std::min(mask.size(), m.last_changes.size());
-    for (int i = 0; i < size; ++i) {
-      for (int j = 0; j < 8; ++j) {
-        if (((mask[i] >> (7 - j)) & 1) != 0) m.last_changes[i].bit_change_counts[j] = 0;
+  bool masks_changed = false;
+  {
+    std::lock_guard lk(mutex_);
+    auto prev_masks = std::move(masks_);
+    masks_.clear();
+    if (settings.suppress_defined_signals) {
+      for (const auto s : sources) {
+        for (const auto &[address, m] : dbc()->getMessages(s)) {
+          masks_[{.source = (uint8_t)s, .address = address}] = m.mask;
+        }
+      }
+      // clear bit change counts
+      for (auto &[id, m] : messages_) {
+        auto &mask = masks_[id];
+        const int size = std::min(mask.size(), m.last_changes.size());
+        for (int i = 0; i < size; ++i) {
+          for (int j = 0; j < 8; ++j) {
+            if (((mask[i] >> (7 - j)) & 1) != 0) m.last_changes[i].bit_change_counts[j] = 0;
+          }
+        }
       }
     }
+    masks_changed = masks_ != prev_masks;
+  }
+  // The checkpoints were replayed with the old masks
+  if (masks_changed) {
+    checkpoints_.clear();
   }
 }
 
@@ -76,6 +84,12 @@ size_t AbstractStream::suppressHighlighted() {
       cnt += last_change.suppressed;
     }
   }
+  auto clear_counts = [](auto &msgs) {
+    for (auto &[_, m] : msgs) {
+      std::for_each(m.last_changes.begin(), m.last_changes.end(), [](auto &c) { c.bit_change_counts.fill(0); });
+    }
+  };
+  std::for_each(checkpoints_.begin(), checkpoints_.end(), [&](auto &cp) { clear_counts(cp.second); });
   return cnt;
 }
 
@@ -132,12 +146,26 @@ void AbstractStream::updateEvent(const MessageId &id, double sec, const uint8_t
   new_msgs_.insert(id);
 }
 
-const std::vector<const CanEvent *> &AbstractStream::events(const MessageId &id) const {
-  static std::vector<const CanEvent *> empty_events;
+const CanEventList &AbstractStream::events(const MessageId &id) const {
+  static CanEventList empty_events;
   auto it = events_.find(id);
   return it != events_.end() ? it->second : empty_events;
 }
 
+double AbstractStream::calcFreq(const MessageId &id, double sec, double window_sec) const {
+  const auto &ev = events(id);
+  uint64_t cur_mono_time = (routeStartTime() + sec) * 1e9;
+  uint64_t first_mono_time = std::max<int64_t>(0, cur_mono_time - window_sec * 1e9);
+  auto first = std::lower_bound(ev.begin(), ev.end(), first_mono_time, CompareCanEvent());
+  auto second = std::lower_bound(first, ev.end(), cur_mono_time, CompareCanEvent());
+  if (first != ev.end() && second != ev.end()) {
+    double duration = ((*second)->mono_time - (*first)->mono_time) / 1e9;
+    uint32_t count = std::distance(first, second);
+    return count / std::max(1.0, duration);
+  }
+  return 0;
+}
+
 const CanData &AbstractStream::lastMessage(const MessageId &id) {
   static CanData empty_data = {};
   auto it = last_msgs.find(id);
@@ -149,26 +177,48 @@ const CanData &AbstractStream::lastMessage(const MessageId &id) {
 void AbstractStream::updateLastMsgsTo(double sec) {
   current_sec_ = sec;
   uint64_t last_ts = (sec + routeStartTime()) * 1e9;
+
+  // Restore the nearest checkpoint before the target time and replay the events since then,
+  // so the byte colors and bit change counts are the same as if the stream had played up to here.
+  // The missing checkpoints on the way are taken, later seeks replay at most CHECKPOINT_INTERVAL of events.
   std::unordered_map<MessageId, CanData> msgs;
-  msgs.reserve(events_.size());
-
-  for (const auto &[id, ev] : events_) {
-    auto it = std::upper_bound(ev.begin(), ev.end(), last_ts, CompareCanEvent());
-    if (it != ev.begin()) {
-      auto prev = std::prev(it);
-      double ts = (*prev)->mono_time / 1e9 - routeStartTime();
-      auto &m = msgs[id];
-      double freq = 0;
-      // Keep suppressed bits.
-      if (auto old_m = messages_.find(id); old_m != messages_.end()) {
-        freq = old_m->second.freq;
-        m.last_changes.reserve(old_m->second.last_changes.size());
-        std::transform(old_m->second.last_changes.cbegin(), old_m->second.last_changes.cend(),
-                       std::back_inserter(m.last_changes),
-                       [](const auto &change) { return CanData::ByteLastChange{.suppressed = change.suppressed}; });
+  uint64_t from_ts = 0;
+  if (auto cp = checkpoints_.upper_bound(last_ts); cp != checkpoints_.begin()) {
+    --cp;
+    from_ts = cp->first;
+    msgs = cp->second;
+  }
+
+  std::unordered_map<MessageId, std::vector<uint8_t>> masks;
+  {
+    std::lock_guard lk(mutex_);
+    masks = masks_;
+  }
+
+  static const std::vector<uint8_t> empty_mask;
+  uint64_t next_checkpoint = (from_ts / CHECKPOINT_INTERVAL + 1) * CHECKPOINT_INTERVAL;
+  auto first = std::lower_bound(all_events_.cbegin(), all_events_.cend(), from_ts, CompareCanEvent());
+  auto last = std::upper_bound(first, all_events_.cend(), last_ts, CompareCanEvent());
+  for (auto it = first; it != last; ++it) {
+    const CanEvent *e = *it;
+    if (e->mono_time >= next_checkpoint) {
+      const uint64_t checkpoint = e->mono_time / CHECKPOINT_INTERVAL * CHECKPOINT_INTERVAL;
+      checkpoints_.emplace(checkpoint, msgs);
+      next_checkpoint = checkpoint + CHECKPOINT_INTERVAL;
+    }
+    MessageId id = {.source = e->src, .address = e->address};
+    auto mask = masks.find(id);
+    msgs[id].compute(id, e->dat, e->size, e->mono_time / 1e9 - routeStartTime(), getSpeed(),
+                     mask != masks.end() ? mask->second : empty_mask);
+  }
+
+  // Keep suppressed bits.
+  for (auto &[id, m] : msgs) {
+    if (auto old_m = messages_.find(id); old_m != messages_.end()) {
+      const size_t size = std::min(m.last_changes.size(), old_m->second.last_changes.size());
+      for (size_t i = 0; i < size; ++i) {
+        m.last_changes[i].suppressed = old_m->second.last_changes[i].suppressed;
       }
-      m.compute(id, (*prev)->dat, (*prev)->size, ts, getSpeed(), {}, freq);
-      m.count = std::distance(ev.begin(), prev) + 1;
     }
   }
 
@@ -183,17 +233,21 @@ void AbstractStream::updateLastMsgsTo(double sec) {
 
 const CanEvent *AbstractStream::newEvent(uint64_t mono_time, const cereal::CanData::Reader &c) {
   auto dat = c.getDat();
-  CanEvent *e = (CanEvent *)event_buffer_->allocate(sizeof(CanEvent) + sizeof(uint8_t) * dat.size());
-  e->src = c.getSrc();
-  e->address = c.getAddress();
+  return newEvent(mono_time, c.getSrc(), c.getAddress(), (const uint8_t *)dat.begin(), dat.size());
+}
+
+const CanEvent *AbstractStream::newEvent(uint64_t mono_time, uint8_t src, uint32_t address, const uint8_t *dat, uint8_t size) {
+  CanEvent *e = (CanEvent *)event_buffer_->allocate(sizeof(CanEvent) + sizeof(uint8_t) * size);
+  e->src = src;
+  e->address = address;
   e->mono_time = mono_time;
-  e->size = dat.size();
-  memcpy(e->dat, (uint8_t *)dat.begin(), e->size);
+  e->size = size;
+  memcpy(e->dat, dat, size);
   return e;
 }
 
 void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
-  static MessageEventsMap msg_events;
+  static std::unordered_map<MessageId, std::vector<const CanEvent *>> msg_events;
   std::for_each(msg_events.begin(), msg_events.end(), [](auto &e) { e.second.clear(); });
 
   // Group events by message ID
@@ -202,20 +256,26 @@ void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
   }
 
   if (!events.empty()) {
+    MessageEventsMap new_events;
     for (const auto &[id, new_e] : msg_events) {
       if (!new_e.empty()) {
-        auto &e = events_[id];
-        auto pos = std::upper_bound(e.cbegin(), e.cend(), new_e.front()->mono_time, CompareCanEvent());
-        e.insert(pos, new_e.cbegin(), new_e.cend());
+        events_[id].merge(new_e);
+        new_events.emplace(id, new_e);
       }
     }
-    auto pos = std::upper_bound(all_events_.cbegin(), all_events_.cend(), events.front()->mono_time, CompareCanEvent());
-    all_events_.insert(pos, events.cbegin(), events.cend());
-    emit eventsMerged(msg_events);
+    all_events_.merge(events);
+    // The batch is sorted, checkpoints after its first event are stale
+    invalidateCheckpoints(events.front()->mono_time);
+    emit eventsMerged(new_events);
   }
   lastest_event_ts = all_events_.empty() ? 0 : all_events_.back()->mono_time;
 }
 
+// Drops the checkpoints that don't include the events merged from from_ts on, they are taken again by the next seeks.
+void AbstractStream::invalidateCheckpoints(uint64_t from_ts) {
+  checkpoints_.erase(checkpoints_.upper_bound(from_ts), checkpoints_.end());
+}
+
 namespace {
 
 enum Color { GREYISH_BLUE, CYAN, RED};
@@ -233,33 +293,24 @@ inline QColor blend(const QColor &a, const QColor &b) {
   return QColor((a.red() + b.red()) / 2, (a.green() + b.green()) / 2, (a.blue() + b.blue()) / 2, (a.alpha() + b.alpha()) / 2);
 }
 
-// Calculate the frequency from the past one minute data
-double calc_freq(const MessageId &msg_id, double current_sec) {
-  const auto &events = can->events(msg_id);
-  uint64_t cur_mono_time = (can->routeStartTime() + current_sec) * 1e9;
-  uint64_t first_mono_time = std::max<int64_t>(0, cur_mono_time - 59 * 1e9);
-  auto first = std::lower_bound(events.begin(), events.end(), first_mono_time, CompareCanEvent());
-  auto second = std::lower_bound(first, events.end(), cur_mono_time, CompareCanEvent());
-  if (first != events.end() && second != events.end()) {
-    double duration = ((*second)->mono_time - (*first)->mono_time) / 1e9;
-    uint32_t count = std::distance(first, second);
-    return count / std::max(1.0, duration);
-  }
-  return 0;
-}
-
 }  // namespace
 
 void CanData::compute(const MessageId &msg_id, const uint8_t *can_data, const int size, double current_sec,
                       double playback_speed, const std::vector<uint8_t> &mask, double in_freq) {
+  // Estimate the frequency from a moving average of the inter-arrival time.
+  constexpr double interval_alpha = 0.05;
+  if (count == 0 || current_sec < ts) {
+    avg_interval = 0;
+  } else if (avg_interval == 0) {
+    avg_interval = current_sec - ts;
+  } else {
+    avg_interval += interval_alpha * ((current_sec - ts) - avg_interval);
+  }
+  freq = in_freq ? in_freq : (avg_interval > 0 ? 1.0 / avg_interval : 0);
+
   ts = current_sec;
   ++count;
 
-  if (auto sec = seconds_since_boot(); (sec - last_freq_update_ts) >= 1) {
-    last_freq_update_ts = sec;
-    freq = !in_freq ? calc_freq(msg_id, ts) : in_freq;
-  }
-
   if (dat.size() != size) {
     dat.resize(size);
     colors.assign(size, QColor(0, 0, 0, 0));
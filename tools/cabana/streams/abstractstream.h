@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -14,7 +15,8 @@
 
 #include "cereal/messaging/messaging.h"
 #include "tools/cabana/dbc/dbcmanager.h"
-#include "tools/cabana/utils/util.h"
+#include "tools/cabana/streams/eventlist.h"
+#include "tools/cabana/utils/widgets.h"
 #include "tools/replay/util.h"
 
 struct CanData {
@@ -35,20 +37,7 @@ struct CanData {
     std::array<uint32_t, 8> bit_change_counts;
   };
   std::vector<ByteLastChange> last_changes;
-  double last_freq_update_ts = 0;
-};
-
-struct CanEvent {
-  uint8_t src;
-  uint32_t address;
-  uint64_t mono_time;
-  uint8_t size;
-  uint8_t dat[];
-};
-
-struct CompareCanEvent {
-  constexpr bool operator()(const CanEvent *const e, uint64_t ts) const { return e->mono_time < ts; }
-  constexpr bool operator()(uint64_t ts, const CanEvent *const e) const { return ts < e->mono_time; }
+  double avg_interval = 0;  // EWMA of the inter-arrival time
 };
 
 struct BusConfig {
@@ -57,7 +46,7 @@ struct BusConfig {
   bool can_fd = false;
 };
 
-typedef std::unordered_map<MessageId, std::vector<const CanEvent *>> MessageEventsMap;
+typedef std::unordered_map<MessageId, CanEventList> MessageEventsMap;
 
 class AbstractStream : public QObject {
   Q_OBJECT
@@ -84,9 +73,11 @@ public:
 
   inline const std::unordered_map<MessageId, CanData> &lastMessages() const { return last_msgs; }
   inline const MessageEventsMap &eventsMap() const { return events_; }
-  inline const std::vector<const CanEvent *> &allEvents() const { return all_events_; }
+  inline const CanEventList &allEvents() const { return all_events_; }
   const CanData &lastMessage(const MessageId &id);
-  const std::vector<const CanEvent *> &events(const MessageId &id) const;
+  const CanEventList &events(const MessageId &id) const;
+  // Exact frequency over the window before sec. Unlike CanData::freq, this searches the events.
+  double calcFreq(const MessageId &id, double sec, double window_sec = 59) const;
 
   size_t suppressHighlighted();
   void clearSuppressed();
@@ -110,10 +101,11 @@ public:
 protected:
   void mergeEvents(const std::vector<const CanEvent *> &events);
   const CanEvent *newEvent(uint64_t mono_time, const cereal::CanData::Reader &c);
+  const CanEvent *newEvent(uint64_t mono_time, uint8_t src, uint32_t address, const uint8_t *dat, uint8_t size);
   void updateEvent(const MessageId &id, double sec, const uint8_t *data, uint8_t size);
   uint64_t lastEventMonoTime() const { return lastest_event_ts; }
 
-  std::vector<const CanEvent *> all_events_;
+  CanEventList all_events_;
   double current_sec_ = 0;
   std::optional<std::pair<double, double>> time_range_;
   uint64_t lastest_event_ts = 0;
@@ -122,9 +114,13 @@ private:
   void updateLastMessages();
   void updateLastMsgsTo(double sec);
   void updateMasks();
+  void invalidateCheckpoints(uint64_t from_ts);
 
   MessageEventsMap events_;
   std::unordered_map<MessageId, CanData> last_msgs;
+  // Snapshots of the message states every CHECKPOINT_INTERVAL of stream time, keyed by mono_time, taken while seeking.
+  // Each snapshot holds the state after all events before its key. (only accessed in UI thread)
+  std::map<uint64_t, std::unordered_map<MessageId, CanData>> checkpoints_;
   std::unique_ptr<MonotonicBuffer> event_buffer_;
 
   // Members accessed in multiple threads. (mutex protected)
@@ -0,0 +1,59 @@
+#include "tools/cabana/streams/eventlist.h"
+
+#include <algorithm>
+#include <cassert>
+
+void CanEventList::const_iterator::locate() {
+  const auto &offsets = list->offsets_;
+  if (block >= list->blocks_.size() || index < offsets[block] || index >= offsets[block + 1]) {
+    block = std::distance(offsets.begin(), std::upper_bound(offsets.begin(), offsets.end(), index)) - 1;
+  }
+}
+
+void CanEventList::merge(const std::vector<const CanEvent *> &events) {
+  if (events.empty()) return;
+  assert(std::is_sorted(events.begin(), events.end(), [](auto l, auto r) { return l->mono_time < r->mono_time; }));
+
+  // Find the blocks overlapping the new events. Events are placed after existing ones with the same time.
+  const uint64_t first_ts = events.front()->mono_time;
+  const uint64_t last_ts = events.back()->mono_time;
+  auto first = std::partition_point(blocks_.begin(), blocks_.end(), [=](auto &b) { return b->back()->mono_time <= first_ts; });
+  auto last = std::partition_point(first, blocks_.end(), [=](auto &b) { return b->front()->mono_time <= last_ts; });
+  // Fill up the previous block instead of leaving it partially filled
+  if (first != blocks_.begin() && (*std::prev(first))->size() < BLOCK_SIZE) {
+    --first;
+  }
+
+  Block existing;
+  for (auto it = first; it != last; ++it) {
+    existing.insert(existing.end(), (*it)->begin(), (*it)->end());
+  }
+  Block merged;
+  merged.reserve(existing.size() + events.size());
+  std::merge(existing.begin(), existing.end(), events.begin(), events.end(), std::back_inserter(merged),
+             [](const CanEvent *l, const CanEvent *r) { return l->mono_time < r->mono_time; });
+
+  std::vector<std::shared_ptr<const Block>> new_blocks;
+  new_blocks.reserve(merged.size() / BLOCK_SIZE + 1);
+  for (size_t i = 0; i < merged.size(); i += BLOCK_SIZE) {
+    auto end = merged.begin() + std::min(merged.size(), i + BLOCK_SIZE);
+    new_blocks.push_back(std::make_shared<const Block>(merged.begin() + i, end));
+  }
+
+  auto pos = blocks_.erase(first, last);
+  blocks_.insert(pos, new_blocks.begin(), new_blocks.end());
+  updateOffsets();
+}
+
+void CanEventList::clear() {
+  blocks_.clear();
+  updateOffsets();
+}
+
+void CanEventList::updateOffsets() {
+  offsets_.resize(blocks_.size() + 1);
+  offsets_[0] = 0;
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    offsets_[i + 1] = offsets_[i] + blocks_[i]->size();
+  }
+}
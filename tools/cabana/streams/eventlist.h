@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+struct CanEvent {
+  uint8_t src;
+  uint32_t address;
+  uint64_t mono_time;
+  uint8_t size;
+  uint8_t dat[];
+};
+
+struct CompareCanEvent {
+  constexpr bool operator()(const CanEvent *const e, uint64_t ts) const { return e->mono_time < ts; }
+  constexpr bool operator()(uint64_t ts, const CanEvent *const e) const { return ts < e->mono_time; }
+};
+
+// A time-ordered list of events stored in sorted fixed-size blocks with a block index.
+// Merging events only rewrites the blocks they overlap in time. Blocks are immutable and shared
+// between copies, so a copy is a cheap snapshot that stays valid while new events are merged.
+class CanEventList {
+public:
+  static constexpr size_t BLOCK_SIZE = 4096;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = const CanEvent *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+
+    const_iterator() = default;
+    const_iterator(const CanEventList *list, size_t index) : list(list), index(index) { locate(); }
+
+    reference operator*() const { return (*list->blocks_[block])[index - list->offsets_[block]]; }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    const_iterator &operator++() {
+      if (++index >= list->offsets_[block + 1]) ++block;
+      return *this;
+    }
+    const_iterator &operator--() {
+      if (--index < list->offsets_[block]) --block;
+      return *this;
+    }
+    const_iterator operator++(int) { auto tmp = *this; ++*this; return tmp; }
+    const_iterator operator--(int) { auto tmp = *this; --*this; return tmp; }
+    const_iterator &operator+=(difference_type n) { index += n; locate(); return *this; }
+    const_iterator &operator-=(difference_type n) { return *this += -n; }
+    const_iterator operator+(difference_type n) const { auto tmp = *this; return tmp += n; }
+    const_iterator operator-(difference_type n) const { auto tmp = *this; return tmp -= n; }
+    friend const_iterator operator+(difference_type n, const const_iterator &it) { return it + n; }
+    difference_type operator-(const const_iterator &other) const { return (difference_type)index - (difference_type)other.index; }
+
+    bool operator==(const const_iterator &other) const { return index == other.index; }
+    bool operator!=(const const_iterator &other) const { return index != other.index; }
+    bool operator<(const const_iterator &other) const { return index < other.index; }
+    bool operator>(const const_iterator &other) const { return index > other.index; }
+    bool operator<=(const const_iterator &other) const { return index <= other.index; }
+    bool operator>=(const const_iterator &other) const { return index >= other.index; }
+
+  private:
+    void locate();
+
+    const CanEventList *list = nullptr;
+    size_t index = 0;
+    size_t block = 0;
+  };
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  CanEventList() : offsets_{0} {}
+  explicit CanEventList(const std::vector<const CanEvent *> &events) : CanEventList() { merge(events); }
+  // events must be sorted by mono_time. Events with the same mono_time are placed after the existing ones.
+  void merge(const std::vector<const CanEvent *> &events);
+  void clear();
+
+  inline size_t size() const { return offsets_.back(); }
+  inline bool empty() const { return size() == 0; }
+  inline const CanEvent *front() const { return blocks_.front()->front(); }
+  inline const CanEvent *back() const { return blocks_.back()->back(); }
+  inline const CanEvent *operator[](size_t i) const { return *const_iterator(this, i); }
+
+  inline const_iterator begin() const { return {this, 0}; }
+  inline const_iterator end() const { return {this, size()}; }
+  inline const_iterator cbegin() const { return begin(); }
+  inline const_iterator cend() const { return end(); }
+  inline const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  inline const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+private:
+  using Block = std::vector<const CanEvent *>;
+  void updateOffsets();
+
+  std::vector<std::shared_ptr<const Block>> blocks_;
+  std::vector<size_t> offsets_;  // index of the first event in each block, followed by the total size
+};
@@ -31,7 +31,9 @@ struct LiveStream::Logger {
   uint64_t start_ts;
 };
 
-LiveStream::LiveStream(QObject *parent) : AbstractStream(parent) {
+static const size_t RECEIVED_EVENTS_CAPACITY = 1 << 18;
+
+LiveStream::LiveStream(QObject *parent) : AbstractStream(parent), received_events_(RECEIVED_EVENTS_CAPACITY) {
   if (settings.log_livestream) {
     logger = std::make_unique<Logger>();
   }
@@ -79,20 +81,54 @@ void LiveStream::handleEvent(kj::ArrayPtr<capnp::word> data) {
   auto event = reader.getRoot<cereal::Event>();
   if (event.which() == cereal::Event::Which::CAN) {
     const uint64_t mono_time = event.getLogMonoTime();
-    std::lock_guard lk(lock);
     for (const auto &c : event.getCan()) {
-      received_events_.push_back(newEvent(mono_time, c));
+      pushEvent(newEvent(mono_time, c));
+    }
+  }
+}
+
+// called in streamThread
+void LiveStream::handleFrames(const std::vector<Frame> &frames) {
+  if (frames.empty()) return;
+
+  if (logger) {
+    MessageBuilder msg;
+    auto evt = msg.initEvent();
+    auto can_data = evt.initCan(frames.size());
+    for (int i = 0; i < frames.size(); ++i) {
+      can_data[i].setAddress(frames[i].address);
+      can_data[i].setSrc(frames[i].src);
+      can_data[i].setBusTime(frames[i].bus_time);
+      can_data[i].setDat(kj::arrayPtr(frames[i].dat, frames[i].size));
     }
+    logger->write(capnp::messageToFlatArray(msg));
+  }
+
+  for (const auto &f : frames) {
+    pushEvent(newEvent(f.mono_time, f.src, f.address, f.dat, f.size));
+  }
+}
+
+// called in streamThread
+void LiveStream::pushEvent(const CanEvent *e) {
+  while (!received_events_.push(e)) {
+    // The UI thread is behind, wait for it to merge the received events
+    if (QThread::currentThread()->isInterruptionRequested()) return;
+    QThread::usleep(100);
   }
 }
 
 void LiveStream::timerEvent(QTimerEvent *event) {
   if (event->timerId() == timer_id) {
-    {
-      // merge events received from live stream thread.
-      std::lock_guard lk(lock);
-      mergeEvents(received_events_);
-      received_events_.clear();
+    // merge events received from live stream thread.
+    if (received_events_.pop_all(pending_events_) > 0) {
+      // kernel timestamps are not guaranteed to be in receive order
+      auto cmp = [](const CanEvent *l, const CanEvent *r) { return l->mono_time < r->mono_time; };
+      if (!std::is_sorted(pending_events_.begin(), pending_events_.end(), cmp)) {
+        std::stable_sort(pending_events_.begin(), pending_events_.end(), cmp);
+      }
+      mergeEvents(pending_events_);
+      pending_events_.clear();
     }
     if (!all_events_.empty()) {
       begin_event_ts = all_events_.front()->mono_time;
@@ -5,6 +5,7 @@
 
 #include <QBasicTimer>
 
+#include "common/queue.h"
 #include "tools/cabana/streams/abstractstream.h"
 
 class LiveStream : public AbstractStream {
@@ -24,17 +25,31 @@ public:
   void seekTo(double sec) override;
 
 protected:
+  struct Frame {
+    uint64_t mono_time;
+    uint8_t src;
+    uint32_t address;
+    uint16_t bus_time = 0;  // panda bus time, only logged
+    uint8_t size;
+    const uint8_t *dat;
+  };
+
   virtual void streamThread() = 0;
   void handleEvent(kj::ArrayPtr<capnp::word> event);
+  // For backends that read frames directly, skips the capnp round trip unless the stream is logged
+  void handleFrames(const std::vector<Frame> &frames);
 
 private:
   void startUpdateTimer();
   void timerEvent(QTimerEvent *event) override;
   void updateEvents();
 
-  std::mutex lock;
+  void pushEvent(const CanEvent *e);
+
   QThread *stream_thread;
-  std::vector<const CanEvent *> received_events_;
+  // Events are allocated by the stream thread and handed over to the UI thread without locking
+  SPSCQueue<const CanEvent *> received_events_;
+  std::vector<const CanEvent *> pending_events_;
 
   int timer_id;
   QBasicTimer update_timer;
@@ -8,6 +8,8 @@
 #include <QThread>
 #include <QTimer>
 
+#include "common/timing.h"
+
 PandaStream::PandaStream(QObject *parent, PandaStreamConfig config_) : config(config_), LiveStream(parent) {
   if (!connect()) {
     throw std::runtime_error("Failed to connect to panda");
@@ -43,6 +45,7 @@ bool PandaStream::connect() {
 
 void PandaStream::streamThread() {
   std::vector<can_frame> raw_can_data;
+  std::vector<Frame> frames;
 
   while (!QThread::currentThread()->isInterruptionRequested()) {
     QThread::msleep(1);
@@ -61,17 +64,13 @@ void PandaStream::streamThread() {
       continue;
     }
 
-    MessageBuilder msg;
-    auto evt = msg.initEvent();
-    auto canData = evt.initCan(raw_can_data.size());
-    for (uint i = 0; i<raw_can_data.size(); i++) {
-      canData[i].setAddress(raw_can_data[i].address);
-      canData[i].setBusTime(raw_can_data[i].busTime);
-      canData[i].setDat(kj::arrayPtr((uint8_t*)raw_can_data[i].dat.data(), raw_can_data[i].dat.size()));
-      canData[i].setSrc(raw_can_data[i].src);
+    const uint64_t mono_time = nanos_since_boot();
+    frames.clear();
+    for (const auto &c : raw_can_data) {
+      frames.push_back({.mono_time = mono_time, .src = (uint8_t)c.src, .address = (uint32_t)c.address,
+                        .bus_time = (uint16_t)c.busTime, .size = (uint8_t)c.dat.size(), .dat = (const uint8_t *)c.dat.data()});
     }
-
-    handleEvent(capnp::messageToFlatArray(msg));
+    handleFrames(frames);
 
     panda->send_heartbeat(false);
   }
@@ -1,15 +1,33 @@
 #include "tools/cabana/streams/socketcanstream.h"
 
+#ifdef __linux__
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <vector>
+
 #include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QFormLayout>
 #include <QHBoxLayout>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QThread>
 
+#include "common/timing.h"
+
 SocketCanStream::SocketCanStream(QObject *parent, SocketCanStreamConfig config_) : config(config_), LiveStream(parent) {
   if (!available()) {
-    throw std::runtime_error("SocketCAN plugin not available");
+    throw std::runtime_error("SocketCAN not available");
   }
 
   qDebug() << "Connecting to SocketCAN device" << config.device;
@@ -18,52 +36,132 @@ SocketCanStream::SocketCanStream(QObject *parent, SocketCanStreamConfig config_)
   }
 }
 
+SocketCanStream::~SocketCanStream() {
+  stop();
+#ifdef __linux__
+  if (sock >= 0) close(sock);
+#endif
+}
+
 bool SocketCanStream::available() {
-  return QCanBus::instance()->plugins().contains("socketcan");
+#ifdef __linux__
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd < 0) return false;
+  close(fd);
+  return true;
+#else
+  return false;
+#endif
 }
 
 bool SocketCanStream::connect() {
-  // Connecting might generate some warnings about missing socketcan/libsocketcan libraries
-  // These are expected and can be ignored, we don't need the advanced features of libsocketcan
-  QString errorString;
-  device.reset(QCanBus::instance()->createDevice("socketcan", config.device, &errorString));
-
-  if (!device) {
-    qDebug() << "Failed to create SocketCAN device" << errorString;
+#ifdef __linux__
+  sock = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (sock < 0) {
+    qDebug() << "Failed to create SocketCAN socket" << strerror(errno);
     return false;
   }
 
-  if (!device->connectDevice()) {
-    qDebug() << "Failed to connect to device";
+  // CAN FD frames are received if the interface supports them, classic frames otherwise
+  int enable = 1;
+  setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable));
+  // Hardware timestamps if the controller has them, kernel receive timestamps otherwise
+  int ts_flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) < 0) {
+    qDebug() << "Failed to enable SocketCAN timestamps" << strerror(errno);
+  }
+  // A large receive buffer absorbs bursts on busy buses
+  int rcvbuf = 8 * 1024 * 1024;
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+  // Wake up regularly to check for interruption
+  timeval timeout = {.tv_sec = 0, .tv_usec = 100000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  ifreq ifr = {};
+  strncpy(ifr.ifr_name, config.device.toStdString().c_str(), IFNAMSIZ - 1);
+  if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
+    qDebug() << "Failed to find SocketCAN device" << config.device << strerror(errno);
+    close(sock);
+    sock = -1;
+    return false;
+  }
+  sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    qDebug() << "Failed to bind to device" << strerror(errno);
+    close(sock);
+    sock = -1;
     return false;
   }
-
   return true;
+#else
+  return false;
+#endif
 }
 
-void SocketCanStream::streamThread() {
-  while (!QThread::currentThread()->isInterruptionRequested()) {
-    QThread::msleep(1);
-
-    auto frames = device->readAllFrames();
-    if (frames.size() == 0) continue;
-
-    MessageBuilder msg;
-    auto evt = msg.initEvent();
-    auto canData = evt.initCan(frames.size());
-
-    for (uint i = 0; i < frames.size(); i++) {
-      if (!frames[i].isValid()) continue;
+#ifdef __linux__
+static inline uint64_t toNanos(const timespec &ts) { return ts.tv_sec * 1000000000ULL + ts.tv_nsec; }
+
+// Converts the kernel timestamp of a frame to the boot clock used for mono_time
+static uint64_t frameMonoTime(const msghdr &hdr, int64_t realtime_offset, int64_t &hw_offset) {
+  for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR((msghdr *)&hdr, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+      const timespec *ts = (const timespec *)CMSG_DATA(cmsg);  // software, deprecated, raw hardware
+      if (uint64_t hw = toNanos(ts[2])) {
+        if (hw_offset == 0) hw_offset = (int64_t)nanos_since_boot() - (int64_t)hw;
+        return hw + hw_offset;
+      }
+      if (uint64_t sw = toNanos(ts[0])) {
+        return sw + realtime_offset;
+      }
+    }
+  }
+  return nanos_since_boot();
+}
+#endif
 
-      canData[i].setAddress(frames[i].frameId());
-      canData[i].setSrc(0);
+void SocketCanStream::streamThread() {
+#ifdef __linux__
+  constexpr int BATCH_SIZE = 64;
+  constexpr size_t CONTROL_SIZE = CMSG_SPACE(3 * sizeof(timespec));
+  std::vector<canfd_frame> frames(BATCH_SIZE);
+  std::vector<iovec> iovs(BATCH_SIZE);
+  std::vector<mmsghdr> msgs(BATCH_SIZE);
+  std::vector<char> control(BATCH_SIZE * CONTROL_SIZE);
+  for (int i = 0; i < BATCH_SIZE; ++i) {
+    iovs[i] = {.iov_base = &frames[i], .iov_len = sizeof(canfd_frame)};
+    msgs[i].msg_hdr = {};
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_control = &control[i * CONTROL_SIZE];
+  }
 
-      auto payload = frames[i].payload();
-      canData[i].setDat(kj::arrayPtr((uint8_t*)payload.data(), payload.size()));
+  std::vector<Frame> received;
+  received.reserve(BATCH_SIZE);
+  while (!QThread::currentThread()->isInterruptionRequested()) {
+    for (auto &m : msgs) {
+      m.msg_hdr.msg_controllen = CONTROL_SIZE;
     }
-
-    handleEvent(capnp::messageToFlatArray(msg));
+    int n = recvmmsg(sock, msgs.data(), BATCH_SIZE, MSG_WAITFORONE, nullptr);
+    if (n <= 0) continue;  // timeout or interrupted
+
+    // Software timestamps use the realtime clock, which may be adjusted
+    const int64_t realtime_offset = (int64_t)nanos_since_boot() - (int64_t)nanos_since_epoch();
+    received.clear();
+    for (int i = 0; i < n; ++i) {
+      const canfd_frame &f = frames[i];
+      if (msgs[i].msg_len < CAN_MTU || (f.can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG))) continue;
+
+      const uint32_t address = f.can_id & ((f.can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+      received.push_back({.mono_time = frameMonoTime(msgs[i].msg_hdr, realtime_offset, hw_offset),
+                          .src = 0, .address = address, .size = f.len, .dat = f.data});
+    }
+    handleFrames(received);
   }
+#endif
 }
 
 AbstractOpenStreamWidget *SocketCanStream::widget(AbstractStream **stream) {
@@ -98,8 +196,13 @@ OpenSocketCanWidget::OpenSocketCanWidget(AbstractStream **stream) : AbstractOpen
 
 void OpenSocketCanWidget::refreshDevices() {
   device_edit->clear();
-  for (auto device : QCanBus::instance()->availableDevices(QStringLiteral("socketcan"))) {
-    device_edit->addItem(device.name());
+  // CAN interfaces have the ARPHRD_CAN (280) link type
+  QDir net_dir("/sys/class/net");
+  for (const QString &name : net_dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+    QFile type(net_dir.filePath(name + "/type"));
+    if (type.open(QIODevice::ReadOnly) && type.readAll().trimmed() == "280") {
+      device_edit->addItem(name);
+    }
   }
 }
 
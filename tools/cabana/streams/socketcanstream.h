@@ -1,10 +1,5 @@
 #pragma once
 
-#include <memory>
-
-#include <QtSerialBus/QCanBus>
-#include <QtSerialBus/QCanBusDevice>
-#include <QtSerialBus/QCanBusDeviceInfo>
 #include <QComboBox>
 
 #include "tools/cabana/streams/livestream.h"
@@ -17,7 +12,7 @@ class SocketCanStream : public LiveStream {
   Q_OBJECT
 public:
   SocketCanStream(QObject *parent, SocketCanStreamConfig config_ = {});
-  ~SocketCanStream() { stop(); }
+  ~SocketCanStream();
   static AbstractOpenStreamWidget *widget(AbstractStream **stream);
   static bool available();
 
@@ -30,7 +25,9 @@ protected:
   bool connect();
 
   SocketCanStreamConfig config = {};
-  std::unique_ptr<QCanBusDevice> device;
+  int sock = -1;
+  // offset from the hardware clock to the boot clock, set on the first hardware timestamp
+  int64_t hw_offset = 0;
 };
 
 class OpenSocketCanWidget : public AbstractOpenStreamWidget {
@@ -1,9 +1,30 @@
 
 #undef INFO
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <QCoreApplication>
 #include <QDir>
+#include <QThread>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/can.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 #include "catch2/catch.hpp"
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/streams/eventlist.h"
+#include "tools/cabana/streams/socketcanstream.h"
+#include "tools/cabana/tools/signalsearch.h"
 
 const std::string TEST_RLOG_URL = "https://commadataci.blob.core.windows.net/openpilotci/0c94aa1e1296d7c6/2021-05-05--19-48-37/0/rlog.bz2";
 
@@ -147,7 +168,7 @@ TEST_CASE("parse_opendbc") {
   QStringList errors;
   for (auto fn : dir.entryList({"*.dbc"}, QDir::Files, QDir::Name)) {
     try {
-      auto dbc = DBCFile(dir.filePath(fn));
+      auto dbc = DBCFile(dir.filePath(fn), false);
     } catch (std::exception &e) {
       errors.push_back(e.what());
     }
@@ -155,3 +176,160 @@ TEST_CASE("parse_opendbc") {
   INFO(errors.join("\n").toStdString());
   REQUIRE(errors.empty());
 }
+
+TEST_CASE("DBCFile cache") {
+  QString fn = QString("%1/%2.dbc").arg(OPENDBC_FILE_PATH, "tesla_can");
+  DBCFile parsed(fn, false);
+  DBCFile cached(fn);  // parsed and saved to the cache
+  DBCFile loaded(fn);  // loaded from the cache
+
+  for (auto dbc : {&cached, &loaded}) {
+    REQUIRE(dbc->generateDBC() == parsed.generateDBC());
+    REQUIRE(dbc->getMessages().size() == parsed.getMessages().size());
+    for (auto &[address, m] : parsed.getMessages()) {
+      auto &other = dbc->getMessages().at(address);
+      REQUIRE(m.getSignals().size() == other.getSignals().size());
+      for (int i = 0; i < m.getSignals().size(); ++i) {
+        REQUIRE(*m.getSignals()[i] == *other.getSignals()[i]);
+      }
+    }
+  }
+}
+
+TEST_CASE("DBCFile benchmark", "[.][benchmark]") {
+  QDir dir(OPENDBC_FILE_PATH);
+  const QStringList files = dir.entryList({"*.dbc"}, QDir::Files, QDir::Name);
+  BENCHMARK("parse opendbc") {
+    for (auto &fn : files) DBCFile(dir.filePath(fn), false);
+  };
+  BENCHMARK("load opendbc from cache") {
+    for (auto &fn : files) DBCFile(dir.filePath(fn));
+  };
+}
+
+TEST_CASE("CanEventList::merge") {
+  const int segments = 20, events_per_segment = 1000;
+  std::vector<CanEvent> events(segments * events_per_segment);
+  for (int i = 0; i < events.size(); ++i) {
+    events[i].mono_time = i * 10;
+  }
+
+  // merge segments in random order
+  std::vector<int> order(segments);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937{42});
+  CanEventList list;
+  for (int n : order) {
+    std::vector<const CanEvent *> segment;
+    for (int i = n * events_per_segment; i < (n + 1) * events_per_segment; ++i) {
+      segment.push_back(&events[i]);
+    }
+    list.merge(segment);
+  }
+
+  REQUIRE(list.size() == events.size());
+  REQUIRE(std::equal(list.begin(), list.end(), events.begin(), [](auto l, auto &r) { return l == &r; }));
+  auto it = std::upper_bound(list.cbegin(), list.cend(), 12345, CompareCanEvent());
+  REQUIRE(std::distance(list.cbegin(), it) == 1235);
+  REQUIRE((*list.rbegin())->mono_time == events.back().mono_time);
+
+  // copies are not affected by later merges
+  CanEventList snapshot = list;
+  list.merge({&events[5]});
+  REQUIRE(snapshot.size() == events.size());
+  REQUIRE(list.size() == events.size() + 1);
+  REQUIRE(list[6] == &events[5]);
+}
+
+TEST_CASE("signal_search") {
+  cabana::Signal props = {};
+  props.is_little_endian = true;
+  auto sigs = signal_search::candidates(props, 16, 4, 8);
+  // 13 4-bit signals in 16 bits down to 9 8-bit signals
+  REQUIRE(sigs.size() == 13 + 12 + 11 + 10 + 9);
+  auto sig = std::find_if(sigs.begin(), sigs.end(), [](auto &s) { return s.start_bit == 0 && s.size == 8; });
+  REQUIRE(sig != sigs.end());
+  REQUIRE(sig->is_little_endian);
+
+  const std::vector<std::array<uint8_t, 2>> dat = {{0x00, 0x00}, {0x34, 0x12}, {0x35, 0x12}};
+  std::vector<std::unique_ptr<uint8_t[]>> storage;
+  std::vector<const CanEvent *> events;
+  for (size_t i = 0; i < dat.size(); ++i) {
+    CanEvent *e = (CanEvent *)storage.emplace_back(new uint8_t[sizeof(CanEvent) + 2]()).get();
+    e->mono_time = i;
+    e->size = 2;
+    memcpy(e->dat, dat[i].data(), 2);
+    events.push_back(e);
+  }
+  CanEventList list(events);
+  auto it = signal_search::findValue(list.begin(), list.end(), *sig, [](double v) { return v == 0x34; });
+  REQUIRE(it - list.begin() == 1);
+  it = signal_search::findValue(list.begin(), list.end(), *sig, [](double v) { return v > 0x40; });
+  REQUIRE(it == list.end());
+}
+
+#ifdef __linux__
+TEST_CASE("SocketCanStream throughput", "[.][socketcan]") {
+  // Hidden, run it with "[socketcan]" on a machine with a vcan device:
+  //   ip link add dev vcan0 type vcan && ip link set up vcan0
+  const char *device = "vcan0";
+  if (!SocketCanStream::available() || if_nametoindex(device) == 0) {
+    FAIL("vcan0 is not available");
+  }
+
+  auto stream = new SocketCanStream(QCoreApplication::instance(), {.device = device});
+  stream->start();
+
+  int tx = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = if_nametoindex(device);
+  REQUIRE(bind(tx, (sockaddr *)&addr, sizeof(addr)) == 0);
+
+  // paced at 50k frames/s, many times the rate of a busy CAN FD bus
+  const int frame_count = 100000, burst = 500;
+  const auto burst_interval = std::chrono::milliseconds(10);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frame_count;) {
+    std::this_thread::sleep_until(start + (i / burst) * burst_interval);
+    for (int end = std::min(i + burst, frame_count); i < end;) {
+      can_frame f = {};
+      f.can_id = 0x100 + i % 16;
+      f.can_dlc = 8;
+      memcpy(f.data, &i, sizeof(i));
+      if (write(tx, &f, sizeof(f)) == sizeof(f)) {
+        ++i;
+      } else {
+        usleep(100);  // tx queue is full
+      }
+    }
+    QCoreApplication::processEvents();
+  }
+  close(tx);
+
+  // events are merged on the update timer
+  const auto sent = std::chrono::steady_clock::now();
+  while (stream->allEvents().size() < frame_count && std::chrono::steady_clock::now() - sent < std::chrono::seconds(5)) {
+    QCoreApplication::processEvents();
+    QThread::msleep(1);
+  }
+  const auto &events = stream->allEvents();
+  const double loss = 1.0 - (double)events.size() / frame_count;
+  INFO("lost " << loss * 100 << "% of " << frame_count << " frames");
+  REQUIRE(loss < 0.01);
+
+  // whatever arrived is unique and in order
+  std::vector<bool> received(frame_count);
+  for (auto it = events.begin(); it != events.end(); ++it) {
+    int i = 0;
+    memcpy(&i, (*it)->dat, sizeof(i));
+    REQUIRE((i >= 0 && i < frame_count && !received[i]));
+    received[i] = true;
+    REQUIRE((*it)->address == 0x100 + i % 16);
+    if (it != events.begin()) REQUIRE((*it)->mono_time >= (*(it - 1))->mono_time);
+  }
+
+  delete stream;
+  can = nullptr;
+}
+#endif
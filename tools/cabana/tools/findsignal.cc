@@ -8,6 +8,8 @@
 #include <QTimer>
 #include <QVBoxLayout>
 
+#include "tools/cabana/tools/signalsearch.h"
+
 // FindSignalModel
 
 QVariant FindSignalModel::headerData(int section, Qt::Orientation orientation, int role) const {
@@ -43,7 +45,7 @@ void FindSignalModel::search(std::function<bool(double)> cmp) {
       last = std::upper_bound(events.cbegin(), events.cend(), last_time, CompareCanEvent());
     }
 
-    auto it = std::find_if(first, last, [&](const CanEvent *e) { return cmp(get_raw_value(e->dat, e->size, s.sig)); });
+    auto it = signal_search::findValue(first, last, s.sig, cmp);
     if (it != last) {
       auto values = s.values;
       values += QString("(%1, %2)").arg((*it)->mono_time / 1e9 - can->routeStartTime(), 0, 'f', 2).arg(get_raw_value((*it)->dat, (*it)->size, s.sig));
@@ -229,16 +231,10 @@ void FindSignalDlg::setInitialSignals() {
       const auto &events = can->events(id);
       auto e = std::lower_bound(events.cbegin(), events.cend(), first_time, CompareCanEvent());
       if (e != events.cend()) {
-        const int total_size = m.dat.size() * 8;
-        for (int size = min_size->value(); size <= max_size->value(); ++size) {
-          for (int start = 0; start <= total_size - size; ++start) {
-            FindSignalModel::SearchSignal s{.id = id, .mono_time = first_time, .sig = sig};
-            s.sig.start_bit = start;
-            s.sig.size = size;
-            updateMsbLsb(s.sig);
-            s.value = get_raw_value((*e)->dat, (*e)->size, s.sig);
-            model->initial_signals.push_back(s);
-          }
+        for (const auto &candidate : signal_search::candidates(sig, m.dat.size() * 8, min_size->value(), max_size->value())) {
+          FindSignalModel::SearchSignal s{.id = id, .mono_time = first_time, .sig = candidate};
+          s.value = get_raw_value((*e)->dat, (*e)->size, s.sig);
+          model->initial_signals.push_back(s);
         }
       }
     }
@@ -1,6 +1,9 @@
 #include "tools/cabana/tools/findsimilarbits.h"
 
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
 
 #include <QGridLayout>
 #include <QHeaderView>
@@ -9,9 +12,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QRadioButton>
-
-#include "tools/cabana/dbc/dbcmanager.h"
-#include "tools/cabana/streams/abstractstream.h"
+#include <QtConcurrent>
 
 FindSimilarBitsDlg::FindSimilarBitsDlg(QWidget *parent) : QDialog(parent, Qt::WindowFlags() | Qt::Window) {
   setWindowTitle(tr("Find similar bits"));
@@ -82,9 +83,18 @@ FindSimilarBitsDlg::FindSimilarBitsDlg(QWidget *parent) : QDialog(parent, Qt::Wi
   table->setEditTriggers(QAbstractItemView::NoEditTriggers);
   table->horizontalHeader()->setStretchLastSection(true);
   main_layout->addWidget(table);
+  main_layout->addWidget(stats_label = new QLabel(this));
+
+  watcher = new QFutureWatcher<std::vector<SimilarBitsEngine::Match>>(this);
+  update_timer = new QTimer(this);
+  update_timer->setSingleShot(true);
+  update_timer->setInterval(100);
 
   setMinimumSize({700, 500});
   QObject::connect(search_btn, &QPushButton::clicked, this, &FindSimilarBitsDlg::find);
+  QObject::connect(watcher, &QFutureWatcherBase::resultReadyAt, this, &FindSimilarBitsDlg::resultReady);
+  QObject::connect(watcher, &QFutureWatcherBase::finished, this, &FindSimilarBitsDlg::finished);
+  QObject::connect(update_timer, &QTimer::timeout, this, &FindSimilarBitsDlg::updateTable);
   QObject::connect(table, &QTableWidget::doubleClicked, [this](const QModelIndex &index) {
     if (index.isValid()) {
       MessageId msg_id = {.source = (uint8_t)find_bus_combo->currentData().toUInt(), .address = table->item(index.row(), 0)->text().toUInt(0, 16)};
@@ -93,17 +103,64 @@ FindSimilarBitsDlg::FindSimilarBitsDlg(QWidget *parent) : QDialog(parent, Qt::Wi
   });
 }
 
+FindSimilarBitsDlg::~FindSimilarBitsDlg() {
+  watcher->cancel();
+  watcher->waitForFinished();
+}
+
 void FindSimilarBitsDlg::find() {
   search_btn->setEnabled(false);
+  results.clear();
+  updateTable();
+
+  const auto &all_events = can->allEvents();
+  if (all_events.empty()) {
+    search_btn->setEnabled(true);
+    return;
+  }
+
+  const MessageId src_id = {.source = (uint8_t)src_bus_combo->currentText().toUInt(), .address = msg_cb->currentData().toUInt()};
+  const uint8_t find_bus = find_bus_combo->currentText().toUInt();
+  const bool equal = equal_combo->currentIndex() == 0;
+  const uint32_t min_msgs_cnt = std::max(0, min_msgs->text().toInt());
+  auto engine = std::make_shared<SimilarBitsEngine>(can->events(src_id), byte_idx_sb->value(), bit_idx_sb->value(),
+                                                    all_events.front()->mono_time, all_events.back()->mono_time, SimilarBitsEngine::DEFAULT_INTERVAL_NS);
+
+  // Take a snapshot of the event lists, new segments may be merged while the workers are running.
+  using Target = std::pair<uint32_t, CanEventList>;
+  QList<Target> targets;
+  for (const auto &[id, events] : can->eventsMap()) {
+    if (id.source == find_bus) targets.push_back({id.address, events});
+  }
+
+  stats_label->setText(tr("Searching %1 messages over %2 samples...").arg(targets.size()).arg(engine->samples()));
+  std::function<std::vector<SimilarBitsEngine::Match>(const Target &)> correlate = [=](const Target &t) {
+    return engine->correlate(t.first, t.second, equal, min_msgs_cnt);
+  };
+  watcher->setFuture(QtConcurrent::mapped(targets, correlate));
+}
+
+void FindSimilarBitsDlg::resultReady(int index) {
+  const auto matches = watcher->resultAt(index);
+  results.insert(results.end(), matches.begin(), matches.end());
+  if (!update_timer->isActive()) update_timer->start();
+}
+
+void FindSimilarBitsDlg::finished() {
+  update_timer->stop();
+  updateTable();
+  stats_label->setText(tr("%1 matches").arg(results.size()));
+  search_btn->setEnabled(true);
+}
+
+void FindSimilarBitsDlg::updateTable() {
+  std::sort(results.begin(), results.end(), [](auto &l, auto &r) { return l.perc < r.perc; });
   table->clear();
-  uint32_t selected_address = msg_cb->currentData().toUInt();
-  auto msg_mismatched = calcBits(src_bus_combo->currentText().toUInt(), selected_address, byte_idx_sb->value(), bit_idx_sb->value(),
-                                 find_bus_combo->currentText().toUInt(), equal_combo->currentIndex() == 0, min_msgs->text().toInt());
-  table->setRowCount(msg_mismatched.size());
+  table->setRowCount(results.size());
   table->setColumnCount(6);
-  table->setHorizontalHeaderLabels({"address", "byte idx", "bit idx", "mismatches", "total msgs", "% mismatched"});
-  for (int i = 0; i < msg_mismatched.size(); ++i) {
-    auto &m = msg_mismatched[i];
+  table->setHorizontalHeaderLabels({"address", "byte idx", "bit idx", "mismatches", "total samples", "% mismatched"});
+  for (int i = 0; i < results.size(); ++i) {
+    auto &m = results[i];
     table->setItem(i, 0, new QTableWidgetItem(QString("%1").arg(m.address, 1, 16)));
     table->setItem(i, 1, new QTableWidgetItem(QString::number(m.byte_idx)));
     table->setItem(i, 2, new QTableWidgetItem(QString::number(m.bit_idx)));
@@ -111,50 +168,4 @@ void FindSimilarBitsDlg::find() {
     table->setItem(i, 4, new QTableWidgetItem(QString::number(m.total)));
     table->setItem(i, 5, new QTableWidgetItem(QString::number(m.perc, 'f', 2)));
   }
-  search_btn->setEnabled(true);
-}
-
-QList<FindSimilarBitsDlg::mismatched_struct> FindSimilarBitsDlg::calcBits(uint8_t bus, uint32_t selected_address, int byte_idx,
-                                                                          int bit_idx, uint8_t find_bus, bool equal, int min_msgs_cnt) {
-  QHash<uint32_t, QVector<uint32_t>> mismatches;
-  QHash<uint32_t, uint32_t> msg_count;
-  const auto &events = can->allEvents();
-  int bit_to_find = -1;
-  for (const CanEvent *e : events) {
-    if (e->src == bus) {
-      if (e->address == selected_address && e->size > byte_idx) {
-        bit_to_find = ((e->dat[byte_idx] >> (7 - bit_idx)) & 1) != 0;
-      }
-    }
-    if (e->src == find_bus) {
-      ++msg_count[e->address];
-      if (bit_to_find == -1) continue;
-
-      auto &mismatched = mismatches[e->address];
-      if (mismatched.size() < e->size * 8) {
-        mismatched.resize(e->size * 8);
-      }
-      for (int i = 0; i < e->size; ++i) {
-        for (int j = 0; j < 8; ++j) {
-          int bit = ((e->dat[i] >> (7 - j)) & 1) != 0;
-          mismatched[i * 8 + j] += equal ? (bit != bit_to_find) : (bit == bit_to_find);
-        }
-      }
-    }
-  }
-
-  QList<mismatched_struct> result;
-  result.reserve(mismatches.size());
-  for (auto it = mismatches.begin(); it != mismatches.end(); ++it) {
-    if (auto cnt = msg_count[it.key()]; cnt > min_msgs_cnt) {
-      auto &mismatched = it.value();
-      for (int i = 0; i < mismatched.size(); ++i) {
-        if (float perc = (mismatched[i] / (double)cnt) * 100; perc < 50) {
-          result.push_back({it.key(), (uint32_t)i / 8, (uint32_t)i % 8, mismatched[i], cnt, perc});
-        }
-      }
-    }
-  }
-  std::sort(result.begin(), result.end(), [](auto &l, auto &r) { return l.perc < r.perc; });
-  return result;
 }
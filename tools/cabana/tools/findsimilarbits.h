@@ -1,34 +1,43 @@
 #pragma once
 
+#include <vector>
+
 #include <QComboBox>
 #include <QDialog>
+#include <QFutureWatcher>
+#include <QLabel>
 #include <QLineEdit>
 #include <QSpinBox>
 #include <QTableWidget>
+#include <QTimer>
 
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/streams/abstractstream.h"
+#include "tools/cabana/tools/similarbits.h"
 
 class FindSimilarBitsDlg : public QDialog {
   Q_OBJECT
 
 public:
   FindSimilarBitsDlg(QWidget *parent);
+  ~FindSimilarBitsDlg();
 
 signals:
   void openMessage(const MessageId &msg_id);
 
 private:
-  struct mismatched_struct {
-    uint32_t address, byte_idx, bit_idx, mismatches, total;
-    float perc;
-  };
-  QList<mismatched_struct> calcBits(uint8_t bus, uint32_t selected_address, int byte_idx, int bit_idx, uint8_t find_bus,
-                                    bool equal, int min_msgs_cnt);
   void find();
+  void resultReady(int index);
+  void finished();
+  void updateTable();
 
+  std::vector<SimilarBitsEngine::Match> results;
+  QFutureWatcher<std::vector<SimilarBitsEngine::Match>> *watcher;
+  QTimer *update_timer;
   QTableWidget *table;
   QComboBox *src_bus_combo, *find_bus_combo, *msg_cb, *equal_combo;
   QSpinBox *byte_idx_sb, *bit_idx_sb;
   QPushButton *search_btn;
   QLineEdit *min_msgs;
+  QLabel *stats_label;
 };
@@ -0,0 +1,25 @@
+#include "tools/cabana/tools/signalsearch.h"
+
+#include <algorithm>
+
+namespace signal_search {
+
+std::vector<cabana::Signal> candidates(const cabana::Signal &sig, int total_size, int min_size, int max_size) {
+  std::vector<cabana::Signal> sigs;
+  for (int size = min_size; size <= max_size; ++size) {
+    for (int start = 0; start <= total_size - size; ++start) {
+      cabana::Signal &s = sigs.emplace_back(sig);
+      s.start_bit = start;
+      s.size = size;
+      updateMsbLsb(s);
+    }
+  }
+  return sigs;
+}
+
+CanEventList::const_iterator findValue(CanEventList::const_iterator first, CanEventList::const_iterator last,
+                                       const cabana::Signal &sig, const std::function<bool(double)> &cmp) {
+  return std::find_if(first, last, [&](const CanEvent *e) { return cmp(get_raw_value(e->dat, e->size, sig)); });
+}
+
+}  // namespace signal_search
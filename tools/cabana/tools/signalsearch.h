@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "tools/cabana/dbc/dbc.h"
+#include "tools/cabana/streams/eventlist.h"
+
+// The search of FindSignalDlg and cabana_batch, on event lists instead of the stream.
+namespace signal_search {
+
+// Every signal of min_size to max_size bits that fits in total_size bits, with the byte order, sign, factor and offset of sig.
+std::vector<cabana::Signal> candidates(const cabana::Signal &sig, int total_size, int min_size, int max_size);
+// The first event in [first, last) whose raw value of sig is accepted by cmp, last if there is none.
+CanEventList::const_iterator findValue(CanEventList::const_iterator first, CanEventList::const_iterator last,
+                                       const cabana::Signal &sig, const std::function<bool(double)> &cmp);
+
+}  // namespace signal_search
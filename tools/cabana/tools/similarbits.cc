@@ -0,0 +1,106 @@
+#include "tools/cabana/tools/similarbits.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t MAX_GRID_SAMPLES = 1 << 20;
+
+inline uint64_t rangeMask(size_t bit, size_t n) {
+  return n == 64 ? ~0ull : ((1ull << n) - 1) << bit;
+}
+
+void setBits(std::vector<uint64_t> &words, size_t from, size_t to) {
+  while (from < to) {
+    const size_t bit = from % 64, n = std::min<size_t>(64 - bit, to - from);
+    words[from / 64] |= rangeMask(bit, n);
+    from += n;
+  }
+}
+
+// Count the samples in [from, to) where the planes differ (equal) or agree (!equal)
+uint32_t countMismatches(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b, size_t from, size_t to, bool equal) {
+  uint32_t count = 0;
+  while (from < to) {
+    const size_t w = from / 64, bit = from % 64, n = std::min<size_t>(64 - bit, to - from);
+    const uint64_t diff = a[w] ^ b[w];
+    count += __builtin_popcountll((equal ? diff : ~diff) & rangeMask(bit, n));
+    from += n;
+  }
+  return count;
+}
+
+inline bool sameData(const CanEvent *l, const CanEvent *r) {
+  return l->size == r->size && memcmp(l->dat, r->dat, l->size) == 0;
+}
+
+}  // namespace
+
+SimilarBitsEngine::SimilarBitsEngine(const CanEventList &src_events, int byte_idx, int bit_idx,
+                                     uint64_t begin_mono_time, uint64_t end_mono_time, uint64_t interval_ns)
+    : begin_mono_time(begin_mono_time) {
+  const uint64_t duration = end_mono_time > begin_mono_time ? end_mono_time - begin_mono_time : 0;
+  this->interval_ns = std::max<uint64_t>(interval_ns, duration / MAX_GRID_SAMPLES + 1);
+  // resample() rounds timestamps up to the next sample, so round up here too or the last event falls off the grid
+  num_samples = (duration + this->interval_ns - 1) / this->interval_ns + 1;
+
+  auto runs = resample(src_events);
+  src_first_sample = runs.empty() ? num_samples : runs.front().sample;
+  fillBitPlane(runs, byte_idx, bit_idx, src_plane);
+}
+
+std::vector<SimilarBitsEngine::Run> SimilarBitsEngine::resample(const CanEventList &events) const {
+  // An event holds its value from the first grid sample at or after its timestamp until the next change.
+  std::vector<Run> runs;
+  for (const CanEvent *e : events) {
+    const uint64_t offset = e->mono_time > begin_mono_time ? e->mono_time - begin_mono_time : 0;
+    const size_t sample = (offset + interval_ns - 1) / interval_ns;
+    if (sample >= num_samples) break;
+
+    if (!runs.empty() && runs.back().sample == sample) {
+      runs.back().e = e;
+      if (runs.size() > 1 && sameData(runs[runs.size() - 2].e, e)) runs.pop_back();
+    } else if (runs.empty() || !sameData(runs.back().e, e)) {
+      runs.push_back({sample, e});
+    }
+  }
+  return runs;
+}
+
+void SimilarBitsEngine::fillBitPlane(const std::vector<Run> &runs, int byte_idx, int bit_idx, std::vector<uint64_t> &plane) const {
+  plane.assign((num_samples + 63) / 64, 0);
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const CanEvent *e = runs[i].e;
+    if (byte_idx < e->size && ((e->dat[byte_idx] >> (7 - bit_idx)) & 1)) {
+      setBits(plane, runs[i].sample, i + 1 < runs.size() ? runs[i + 1].sample : num_samples);
+    }
+  }
+}
+
+std::vector<SimilarBitsEngine::Match> SimilarBitsEngine::correlate(uint32_t address, const CanEventList &events,
+                                                                   bool equal, uint32_t min_msgs_cnt) const {
+  std::vector<Match> result;
+  if (events.size() <= min_msgs_cnt) return result;
+
+  const auto runs = resample(events);
+  if (runs.empty()) return result;
+
+  // Only compare samples where both the source and the target message have been seen
+  const size_t first_sample = std::max(src_first_sample, runs.front().sample);
+  if (first_sample >= num_samples) return result;
+
+  const uint32_t total = num_samples - first_sample;
+  const int size = (*std::max_element(runs.begin(), runs.end(), [](auto &l, auto &r) { return l.e->size < r.e->size; })).e->size;
+  std::vector<uint64_t> plane;
+  for (int i = 0; i < size; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      fillBitPlane(runs, i, j, plane);
+      uint32_t mismatches = countMismatches(src_plane, plane, first_sample, num_samples, equal);
+      if (float perc = (mismatches / (double)total) * 100; perc < 50) {
+        result.push_back({address, (uint32_t)i, (uint32_t)j, mismatches, total, perc});
+      }
+    }
+  }
+  return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "tools/cabana/streams/eventlist.h"
+
+// Resamples message bit histories onto a common time grid of packed 64-bit words (sample-and-hold),
+// so the source bit can be compared against every bit of a message with XOR + popcount.
+class SimilarBitsEngine {
+public:
+  struct Match {
+    uint32_t address, byte_idx, bit_idx, mismatches, total;
+    float perc;
+  };
+
+  static constexpr uint64_t DEFAULT_INTERVAL_NS = 10'000'000;  // 10ms
+
+  SimilarBitsEngine(const CanEventList &src_events, int byte_idx, int bit_idx,
+                    uint64_t begin_mono_time, uint64_t end_mono_time, uint64_t interval_ns);
+  // Thread safe. Returns the bits of the message that match the source bit in less than half of the samples.
+  std::vector<Match> correlate(uint32_t address, const CanEventList &events, bool equal, uint32_t min_msgs_cnt) const;
+  inline size_t samples() const { return num_samples; }
+
+private:
+  struct Run {
+    size_t sample;
+    const CanEvent *e;
+  };
+  std::vector<Run> resample(const CanEventList &events) const;
+  void fillBitPlane(const std::vector<Run> &runs, int byte_idx, int bit_idx, std::vector<uint64_t> &plane) const;
+
+  uint64_t begin_mono_time, interval_ns;
+  size_t num_samples = 0;
+  size_t src_first_sample = 0;
+  std::vector<uint64_t> src_plane;
+};
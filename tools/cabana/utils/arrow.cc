@@ -0,0 +1,256 @@
+#include "tools/cabana/utils/arrow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace arrow_ipc {
+
+namespace {
+
+const char MAGIC[] = "ARROW1";
+const int16_t METADATA_V5 = 4;
+enum MessageHeader : uint8_t { SCHEMA = 1, RECORD_BATCH = 3 };
+enum Type : uint8_t { FLOATING_POINT = 3 };
+const int16_t PRECISION_DOUBLE = 2;
+
+struct FieldNode {
+  int64_t length;
+  int64_t null_count;
+};
+
+struct Buffer {
+  int64_t offset;
+  int64_t length;
+};
+
+// A minimal flatbuffer builder that lays out objects front to back. Offsets to child objects
+// are reserved in the parent and patched after the child has been written behind it.
+class FlatBufferBuilder {
+public:
+  struct Table {
+    size_t start;
+    std::vector<std::pair<int, size_t>> fields;
+  };
+
+  FlatBufferBuilder() { put<uint32_t>(0); }  // offset to the root table
+
+  template <typename T>
+  size_t put(T v) {
+    align(sizeof(T));
+    size_t pos = buf.size();
+    buf.append((const char *)&v, sizeof(T));
+    return pos;
+  }
+  void align(size_t n) {
+    buf.append((n - buf.size() % n) % n, '\0');
+  }
+  void patch(size_t pos, size_t target) {
+    uint32_t offset = target - pos;
+    memcpy(&buf[pos], &offset, sizeof(offset));
+  }
+
+  Table startTable() { return {put<int32_t>(0), {}}; }
+  template <typename T>
+  void addScalar(Table &t, int id, T v) { t.fields.push_back({id, put<T>(v)}); }
+  size_t addOffset(Table &t, int id) {
+    size_t pos = put<uint32_t>(0);
+    t.fields.push_back({id, pos});
+    return pos;
+  }
+  // Writes the vtable behind the table. Children must be written after this.
+  size_t endTable(const Table &t) {
+    int max_id = -1;
+    for (auto &f : t.fields) max_id = std::max(max_id, f.first);
+    std::vector<uint16_t> offsets(max_id + 1, 0);
+    for (auto &[id, pos] : t.fields) offsets[id] = pos - t.start;
+
+    const uint16_t table_size = buf.size() - t.start;
+    const size_t vtable = put<uint16_t>(4 + 2 * offsets.size());
+    put<uint16_t>(table_size);
+    for (auto o : offsets) put<uint16_t>(o);
+
+    int32_t soffset = (int32_t)t.start - (int32_t)vtable;
+    memcpy(&buf[t.start], &soffset, sizeof(soffset));
+    return t.start;
+  }
+
+  size_t string(const std::string &s) {
+    size_t pos = put<uint32_t>(s.size());
+    buf.append(s);
+    buf.push_back('\0');
+    return pos;
+  }
+  // Reserves a vector of n offsets, the slots are patched later
+  size_t offsetVector(size_t n, std::vector<size_t> &slots) {
+    size_t pos = put<uint32_t>(n);
+    for (size_t i = 0; i < n; ++i) slots.push_back(put<uint32_t>(0));
+    return pos;
+  }
+  // Vector of 8 byte aligned structs
+  template <typename T>
+  size_t structVector(const std::vector<T> &v) {
+    while (buf.size() % 8 != 4) buf.push_back('\0');
+    size_t pos = put<uint32_t>(v.size());
+    buf.append((const char *)v.data(), v.size() * sizeof(T));
+    return pos;
+  }
+
+  std::string finish(size_t root) {
+    patch(0, root);
+    align(8);
+    return std::move(buf);
+  }
+
+private:
+  std::string buf;
+};
+
+size_t writeField(FlatBufferBuilder &fb, const std::string &name) {
+  auto t = fb.startTable();
+  size_t name_offset = fb.addOffset(t, 0);
+  fb.addScalar<uint8_t>(t, 1, true);  // nullable
+  fb.addScalar<uint8_t>(t, 2, FLOATING_POINT);
+  size_t type_offset = fb.addOffset(t, 3);
+  size_t children_offset = fb.addOffset(t, 5);
+  size_t field = fb.endTable(t);
+
+  fb.patch(name_offset, fb.string(name));
+  auto type = fb.startTable();
+  fb.addScalar<int16_t>(type, 0, PRECISION_DOUBLE);
+  fb.patch(type_offset, fb.endTable(type));
+  std::vector<size_t> no_children;
+  fb.patch(children_offset, fb.offsetVector(0, no_children));
+  return field;
+}
+
+size_t writeSchema(FlatBufferBuilder &fb, const std::vector<std::string> &names) {
+  auto t = fb.startTable();
+  fb.addScalar<int16_t>(t, 0, 0);  // little endian
+  size_t fields_offset = fb.addOffset(t, 1);
+  size_t schema = fb.endTable(t);
+
+  std::vector<size_t> slots;
+  fb.patch(fields_offset, fb.offsetVector(names.size(), slots));
+  for (size_t i = 0; i < names.size(); ++i) {
+    fb.patch(slots[i], writeField(fb, names[i]));
+  }
+  return schema;
+}
+
+// Encapsulated message: continuation marker, metadata size, metadata padded to 8 bytes
+std::string encapsulate(const std::string &metadata) {
+  std::string msg(8, '\0');
+  uint32_t continuation = 0xFFFFFFFF;
+  int32_t size = metadata.size();
+  memcpy(&msg[0], &continuation, 4);
+  memcpy(&msg[4], &size, 4);
+  return msg + metadata;
+}
+
+std::string message(MessageHeader type, int64_t body_length, const std::vector<std::string> *names,
+                    int64_t length = 0, const std::vector<FieldNode> *nodes = nullptr, const std::vector<Buffer> *buffers = nullptr) {
+  FlatBufferBuilder fb;
+  auto t = fb.startTable();
+  fb.addScalar<int16_t>(t, 0, METADATA_V5);
+  fb.addScalar<uint8_t>(t, 1, type);
+  size_t header_offset = fb.addOffset(t, 2);
+  fb.addScalar<int64_t>(t, 3, body_length);
+  size_t root = fb.endTable(t);
+
+  if (type == SCHEMA) {
+    fb.patch(header_offset, writeSchema(fb, *names));
+  } else {
+    auto batch = fb.startTable();
+    fb.addScalar<int64_t>(batch, 0, length);
+    size_t nodes_offset = fb.addOffset(batch, 1);
+    size_t buffers_offset = fb.addOffset(batch, 2);
+    fb.patch(header_offset, fb.endTable(batch));
+    fb.patch(nodes_offset, fb.structVector(*nodes));
+    fb.patch(buffers_offset, fb.structVector(*buffers));
+  }
+  return encapsulate(fb.finish(root));
+}
+
+inline void pad(std::string &s) {
+  s.append((8 - s.size() % 8) % 8, '\0');
+}
+
+}  // namespace
+
+RecordBatch encodeRecordBatch(const std::vector<std::vector<double>> &columns) {
+  const size_t rows = columns.empty() ? 0 : columns[0].size();
+  std::vector<FieldNode> nodes;
+  std::vector<Buffer> buffers;
+  std::string body;
+  for (const auto &values : columns) {
+    std::string validity((rows + 7) / 8, '\0');
+    int64_t null_count = 0;
+    for (size_t i = 0; i < rows; ++i) {
+      if (std::isnan(values[i])) {
+        ++null_count;
+      } else {
+        validity[i / 8] |= 1 << (i % 8);
+      }
+    }
+    nodes.push_back({(int64_t)rows, null_count});
+    if (null_count > 0) {
+      buffers.push_back({(int64_t)body.size(), (int64_t)validity.size()});
+      body += validity;
+      pad(body);
+    } else {
+      buffers.push_back({(int64_t)body.size(), 0});
+    }
+    buffers.push_back({(int64_t)body.size(), (int64_t)(rows * sizeof(double))});
+    body.append((const char *)values.data(), rows * sizeof(double));
+    pad(body);
+  }
+
+  RecordBatch batch;
+  batch.data = message(RECORD_BATCH, body.size(), nullptr, rows, &nodes, &buffers);
+  batch.metadata_length = batch.data.size();
+  batch.body_length = body.size();
+  batch.data += body;
+  return batch;
+}
+
+std::string FileWriter::begin() {
+  std::string header(MAGIC, 6);
+  pad(header);
+  header += message(SCHEMA, 0, &names);
+  offset = header.size();
+  return header;
+}
+
+const std::string &FileWriter::append(const RecordBatch &batch) {
+  blocks.push_back({offset, batch.metadata_length, 0, batch.body_length});
+  offset += batch.data.size();
+  return batch.data;
+}
+
+std::string FileWriter::finish() {
+  // end-of-stream marker
+  std::string tail(8, '\0');
+  memset(&tail[0], 0xFF, 4);
+
+  FlatBufferBuilder fb;
+  auto t = fb.startTable();
+  fb.addScalar<int16_t>(t, 0, METADATA_V5);
+  size_t schema_offset = fb.addOffset(t, 1);
+  size_t dictionaries_offset = fb.addOffset(t, 2);
+  size_t batches_offset = fb.addOffset(t, 3);
+  size_t root = fb.endTable(t);
+  fb.patch(schema_offset, writeSchema(fb, names));
+  fb.patch(dictionaries_offset, fb.structVector(std::vector<Block>{}));
+  fb.patch(batches_offset, fb.structVector(blocks));
+  std::string footer = fb.finish(root);
+
+  int32_t footer_size = footer.size();
+  tail += footer;
+  tail.append((const char *)&footer_size, sizeof(footer_size));
+  tail.append(MAGIC, 6);
+  return tail;
+}
+
+}  // namespace arrow_ipc
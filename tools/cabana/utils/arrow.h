@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A minimal writer for the Arrow IPC file format (a.k.a. Feather V2), so decoded signals can be loaded
+// with pyarrow/pandas without an Arrow dependency. All columns are nullable float64, NaN is written as null.
+namespace arrow_ipc {
+
+struct RecordBatch {
+  std::string data;  // encapsulated message: prefix, metadata and body
+  int32_t metadata_length = 0;
+  int64_t body_length = 0;
+};
+
+// Encodes a record batch, thread safe.
+RecordBatch encodeRecordBatch(const std::vector<std::vector<double>> &columns);
+
+class FileWriter {
+public:
+  FileWriter(const std::vector<std::string> &column_names) : names(column_names) {}
+  // Returns the bytes to write at the beginning of the file
+  std::string begin();
+  // Returns the bytes to write for the batch
+  const std::string &append(const RecordBatch &batch);
+  // Returns the bytes to write at the end of the file
+  std::string finish();
+
+private:
+  struct Block {
+    int64_t offset;
+    int32_t metadata_length;
+    int32_t padding;
+    int64_t body_length;
+  };
+  std::vector<std::string> names;
+  std::vector<Block> blocks;
+  int64_t offset = 0;
+};
+
+}  // namespace arrow_ipc
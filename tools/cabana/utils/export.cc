@@ -1,47 +1,154 @@
 #include "tools/cabana/utils/export.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
 #include <QFile>
-#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
 
-#include "tools/cabana/streams/abstractstream.h"
+#include "tools/cabana/utils/arrow.h"
 
 namespace utils {
 
-void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id) {
-  QFile file(file_name);
-  if (file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
-    const uint64_t start_time = can->routeStartTime();
-    QTextStream stream(&file);
-    stream << "time,addr,bus,data\n";
-    for (auto e : msg_id ? can->events(*msg_id) : can->allEvents()) {
-      stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
-             << "0x" << QString::number(e->address, 16) << "," << e->src << ","
-             << "0x" << QByteArray::fromRawData((const char *)e->dat, e->size).toHex().toUpper() << "\n";
+namespace {
+
+const size_t CHUNK_SIZE = 32 * 1024;
+
+// Formats chunks of [0, total) in parallel on the global thread pool and writes them in order.
+// The next batch of chunks is formatted while the previous one is being written.
+template <typename Chunk>
+bool runPipeline(size_t total, std::function<Chunk(size_t, size_t)> format, std::function<bool(const Chunk &)> write,
+                 const ExportProgress &progress) {
+  using Range = std::pair<size_t, size_t>;
+  const size_t batch_size = CHUNK_SIZE * std::max(1, QThread::idealThreadCount());
+  auto formatBatch = [&](size_t begin) {
+    std::vector<Range> ranges;
+    for (size_t i = begin; i < std::min(total, begin + batch_size); i += CHUNK_SIZE) {
+      ranges.push_back({i, std::min(total, i + CHUNK_SIZE)});
+    }
+    std::function<Chunk(const Range &)> fn = [format](const Range &r) { return format(r.first, r.second); };
+    return QtConcurrent::mapped(ranges, fn);
+  };
+
+  QFuture<Chunk> pending = formatBatch(0);
+  for (size_t begin = 0; begin < total; begin += batch_size) {
+    const QList<Chunk> chunks = pending.results();
+    if (begin + batch_size < total) {
+      pending = formatBatch(begin + batch_size);
+    }
+    bool ok = std::all_of(chunks.begin(), chunks.end(), write);
+    if (!ok || (progress && !progress(std::min(total, begin + batch_size) * 100 / total))) {
+      pending.cancel();
+      pending.waitForFinished();
+      return false;
     }
   }
+  return true;
 }
 
-void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
+bool writeFile(const QString &file_name, const std::function<bool(QFile &)> &write) {
   QFile file(file_name);
-  if (auto msg = dbc()->msg(msg_id); msg && msg->sigs.size() && file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
-    QTextStream stream(&file);
-    stream << "time,addr,bus";
-    for (auto s : msg->sigs)
-      stream << "," << s->name;
-    stream << "\n";
-
-    const uint64_t start_time = can->routeStartTime();
-    for (auto e : can->events(msg_id)) {
-      stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
-             << "0x" << QString::number(e->address, 16) << "," << e->src;
-      for (auto s : msg->sigs) {
+  if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+
+  bool success = write(file);
+  file.close();
+  if (!success) file.remove();
+  return success;
+}
+
+inline void appendHex(QByteArray &out, const uint8_t *dat, int size) {
+  static const char hex[] = "0123456789ABCDEF";
+  for (int i = 0; i < size; ++i) {
+    out.append(hex[dat[i] >> 4]);
+    out.append(hex[dat[i] & 0xF]);
+  }
+}
+
+}  // namespace
+
+bool exportToCSV(const QString &file_name, const CanEventList &events, double start_sec, const ExportProgress &progress) {
+  auto format = [&](size_t begin, size_t end) {
+    QByteArray out;
+    out.reserve((end - begin) * 48);
+    char buf[64];
+    for (auto it = events.begin() + begin, last = events.begin() + end; it != last; ++it) {
+      const CanEvent *e = *it;
+      out.append(buf, snprintf(buf, sizeof(buf), "%.2f,0x%x,%d,0x", (e->mono_time / 1e9) - start_sec, e->address, e->src));
+      appendHex(out, e->dat, e->size);
+      out.append('\n');
+    }
+    return out;
+  };
+
+  return writeFile(file_name, [&](QFile &file) {
+    return file.write("time,addr,bus,data\n") > 0 &&
+           runPipeline<QByteArray>(events.size(), format, [&](auto &chunk) { return file.write(chunk) == chunk.size(); }, progress);
+  });
+}
+
+bool exportSignalsToCSV(const QString &file_name, const cabana::Msg &msg, const CanEventList &events, double start_sec,
+                        const ExportProgress &progress) {
+  if (msg.sigs.empty()) return false;
+
+  auto format = [&](size_t begin, size_t end) {
+    QByteArray out;
+    out.reserve((end - begin) * (24 + msg.sigs.size() * 8));
+    char buf[512];
+    for (auto it = events.begin() + begin, last = events.begin() + end; it != last; ++it) {
+      const CanEvent *e = *it;
+      out.append(buf, snprintf(buf, sizeof(buf), "%.2f,0x%x,%d", (e->mono_time / 1e9) - start_sec, e->address, e->src));
+      for (auto s : msg.sigs) {
         double value = 0;
         s->getValue(e->dat, e->size, &value);
-        stream << "," << QString::number(value, 'f', s->precision);
+        out.append(buf, std::min<int>(sizeof(buf) - 1, snprintf(buf, sizeof(buf), ",%.*f", s->precision, value)));
       }
-      stream << "\n";
+      out.append('\n');
+    }
+    return out;
+  };
+
+  return writeFile(file_name, [&](QFile &file) {
+    QByteArray header = "time,addr,bus";
+    for (auto s : msg.sigs) {
+      header += "," + s->name.toUtf8();
     }
+    return file.write(header + "\n") > 0 &&
+           runPipeline<QByteArray>(events.size(), format, [&](auto &chunk) { return file.write(chunk) == chunk.size(); }, progress);
+  });
+}
+
+bool exportSignalsToArrow(const QString &file_name, const cabana::Msg &msg, const CanEventList &events, double start_sec,
+                          const ExportProgress &progress) {
+  auto format = [&](size_t begin, size_t end) {
+    std::vector<std::vector<double>> columns(msg.sigs.size() + 1);
+    for (auto &c : columns) c.reserve(end - begin);
+    for (auto it = events.begin() + begin, last = events.begin() + end; it != last; ++it) {
+      const CanEvent *e = *it;
+      columns[0].push_back((e->mono_time / 1e9) - start_sec);
+      for (size_t i = 0; i < msg.sigs.size(); ++i) {
+        double value = 0;
+        // null if the multiplexed signal is not present
+        columns[i + 1].push_back(msg.sigs[i]->getValue(e->dat, e->size, &value) ? value : std::numeric_limits<double>::quiet_NaN());
+      }
+    }
+    return arrow_ipc::encodeRecordBatch(columns);
+  };
+
+  std::vector<std::string> names = {"time"};
+  for (auto s : msg.sigs) {
+    names.push_back(s->name.toStdString());
   }
+  arrow_ipc::FileWriter writer(names);
+  return writeFile(file_name, [&](QFile &file) {
+    auto write = [&](const std::string &data) { return file.write(data.data(), data.size()) == (qint64)data.size(); };
+    return write(writer.begin()) &&
+           runPipeline<arrow_ipc::RecordBatch>(events.size(), format, [&](auto &batch) { return write(writer.append(batch)); }, progress) &&
+           write(writer.finish());
+  });
 }
 
 }  // namespace utils
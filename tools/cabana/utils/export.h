@@ -1,10 +1,20 @@
 #pragma once
 
-#include <optional>
+#include <functional>
 
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/streams/eventlist.h"
 
 namespace utils {
-void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id = std::nullopt);
-void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id);
+// Called with the progress in percent. Return false to cancel the export.
+typedef std::function<bool(int)> ExportProgress;
+
+// Times are written relative to start_sec. Chunks of events are formatted in parallel and written in order.
+// The file is removed on failure or cancellation.
+bool exportToCSV(const QString &file_name, const CanEventList &events, double start_sec, const ExportProgress &progress = nullptr);
+bool exportSignalsToCSV(const QString &file_name, const cabana::Msg &msg, const CanEventList &events, double start_sec,
+                        const ExportProgress &progress = nullptr);
+// Arrow IPC file with a time column and a column per signal, readable by pyarrow.feather/pandas.read_feather
+bool exportSignalsToArrow(const QString &file_name, const cabana::Msg &msg, const CanEventList &events, double start_sec,
+                          const ExportProgress &progress = nullptr);
 }  // namespace utils
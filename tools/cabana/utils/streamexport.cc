@@ -0,0 +1,86 @@
+#include "tools/cabana/utils/streamexport.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <QApplication>
+#include <QFutureWatcher>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include "tools/cabana/streams/abstractstream.h"
+
+namespace utils {
+
+namespace {
+
+// Runs the export in a background thread, with a progress dialog to cancel it.
+void runInBackground(const QString &file_name, std::function<bool(const ExportProgress &)> job) {
+  struct State {
+    std::atomic<int> progress = 0;
+    std::atomic<bool> canceled = false;
+  };
+  auto state = std::make_shared<State>();
+  auto dlg = new QProgressDialog(QObject::tr("Exporting %1").arg(file_name), QObject::tr("Cancel"), 0, 100, qApp->activeWindow());
+  dlg->setMinimumDuration(500);
+  auto timer = new QTimer(dlg);
+  auto watcher = new QFutureWatcher<bool>(dlg);
+  QObject::connect(timer, &QTimer::timeout, dlg, [dlg, state]() { dlg->setValue(state->progress); });
+  QObject::connect(dlg, &QProgressDialog::canceled, [state]() { state->canceled = true; });
+  // The events are owned by the stream, stop before it is deleted
+  QObject::connect(StreamNotifier::instance(), &StreamNotifier::changingStream, dlg, [state, watcher]() {
+    state->canceled = true;
+    watcher->waitForFinished();
+  });
+  QObject::connect(watcher, &QFutureWatcher<bool>::finished, dlg, [=]() {
+    if (!watcher->result() && !state->canceled) {
+      QMessageBox::warning(dlg->parentWidget(), QObject::tr("Export"), QObject::tr("Failed to export %1").arg(file_name));
+    }
+    dlg->deleteLater();
+  });
+  timer->start(100);
+  watcher->setFuture(QtConcurrent::run([job, state]() {
+    return job([state](int percent) {
+      state->progress = percent;
+      return !state->canceled;
+    });
+  }));
+}
+
+}  // namespace
+
+void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id) {
+  const double start_sec = can->routeStartTime();
+  // The copy is a snapshot, new events may be merged while exporting.
+  CanEventList events = msg_id ? can->events(*msg_id) : can->allEvents();
+  runInBackground(file_name, [=](const ExportProgress &progress) {
+    return exportToCSV(file_name, events, start_sec, progress);
+  });
+}
+
+void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
+  if (auto m = dbc()->msg(msg_id)) {
+    const double start_sec = can->routeStartTime();
+    cabana::Msg msg = *m;
+    CanEventList events = can->events(msg_id);
+    runInBackground(file_name, [=](const ExportProgress &progress) {
+      return exportSignalsToCSV(file_name, msg, events, start_sec, progress);
+    });
+  }
+}
+
+void exportSignalsToArrow(const QString &file_name, const MessageId &msg_id) {
+  if (auto m = dbc()->msg(msg_id)) {
+    const double start_sec = can->routeStartTime();
+    cabana::Msg msg = *m;
+    CanEventList events = can->events(msg_id);
+    runInBackground(file_name, [=](const ExportProgress &progress) {
+      return exportSignalsToArrow(file_name, msg, events, start_sec, progress);
+    });
+  }
+}
+
+}  // namespace utils
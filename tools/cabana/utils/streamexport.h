@@ -0,0 +1,12 @@
+#pragma once
+
+#include <optional>
+
+#include "tools/cabana/utils/export.h"
+
+namespace utils {
+// Export from the current stream in a background thread, with a progress dialog.
+void exportToCSV(const QString &file_name, std::optional<MessageId> msg_id = std::nullopt);
+void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id);
+void exportSignalsToArrow(const QString &file_name, const MessageId &msg_id);
+}  // namespace utils
@@ -12,7 +12,7 @@
 #include <QTabBar>
 
 #include "selfdrive/ui/qt/widgets/cameraview.h"
-#include "tools/cabana/utils/util.h"
+#include "tools/cabana/utils/widgets.h"
 #include "tools/replay/logreader.h"
 
 struct AlertInfo {
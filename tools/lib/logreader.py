@@ -6,6 +6,7 @@ import capnp
 import enum
 import os
 import pathlib
+import struct
 import sys
 import tqdm
 import urllib.parse
@@ -27,6 +28,50 @@ LogIterable = Iterable[LogMessage]
 RawLogIterable = Iterable[bytes]
 
 
+ZSTD_FRAME_MAGIC = 0xFD2FB528
+
+
+def zstd_frame_size(dat: bytes, offset: int) -> int:
+  # size of the zstd or skippable frame at offset, 0 if it is cut off
+  # https://github.com/facebook/zstd/blob/dev/doc/zstd_compression_format.md#frames
+  if offset + 8 > len(dat):
+    return 0
+  magic, = struct.unpack_from("<I", dat, offset)
+  if magic & 0xFFFFFFF0 == 0x184D2A50:
+    size = 8 + struct.unpack_from("<I", dat, offset + 4)[0]
+    return size if offset + size <= len(dat) else 0
+  if magic != ZSTD_FRAME_MAGIC:
+    raise ValueError(f"invalid zstd frame at {offset}")
+
+  descriptor = dat[offset + 4]
+  single_segment = (descriptor >> 5) & 1
+  pos = offset + 5 + (1 - single_segment) + (0, 1, 2, 4)[descriptor & 3] + (single_segment, 2, 4, 8)[descriptor >> 6]
+  while pos + 3 <= len(dat):
+    block_header = int.from_bytes(dat[pos:pos + 3], "little")
+    # RLE blocks hold a single byte
+    pos += 3 + (1 if (block_header >> 1) & 3 == 1 else block_header >> 3)
+    if block_header & 1:
+      pos += 4 * ((descriptor >> 2) & 1)  # checksum
+      return pos - offset if pos <= len(dat) else 0
+  return 0
+
+
+def decompress_zst(dat: bytes) -> bytes:
+  # logs compressed by loggerd are independent frames followed by a skippable frame with the index, see
+  # system/loggerd/zstd_index.h. The frames are decompressed one at a time, so a log that was cut off
+  # before its index was written reads up to its last complete frame.
+  out, offset = [], 0
+  while offset < len(dat):
+    size = zstd_frame_size(dat, offset)
+    if size == 0:
+      warnings.warn("Truncated zstd log", RuntimeWarning, stacklevel=2)
+      break
+    if struct.unpack_from("<I", dat, offset)[0] == ZSTD_FRAME_MAGIC:
+      out.append(zstd.decompress(dat[offset:offset + size]))
+    offset += size
+  return b"".join(out)
+
+
 class _LogFileReader:
   def __init__(self, fn, canonicalize=True, only_union_types=False, sort_by_time=False, dat=None):
     self.data_version = None
@@ -46,7 +91,7 @@ class _LogFileReader:
       dat = bz2.decompress(dat)
     elif ext == ".zst" or dat.startswith(b'\x28\xB5\x2F\xFD'):
       # https://github.com/facebook/zstd/blob/dev/doc/zstd_compression_format.md#zstandard-frames
-      dat = zstd.decompress(dat)
+      dat = decompress_zst(dat)
 
     ents = capnp_log.Event.read_multiple_bytes(dat)
 
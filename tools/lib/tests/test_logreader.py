@@ -6,6 +6,7 @@ import tempfile
 import os
 import pytest
 import requests
+import zstd
 
 from parameterized import parameterized
 
@@ -249,3 +250,18 @@ class TestLogReader:
       msgs = list(LogReader(qlog.name, only_union_types=True))
       assert len(msgs) == num_msgs
       [m.which() for m in msgs]
+
+  def test_zst_without_index(self):
+    # a segment that was not closed has no frame index and may end in a partial frame
+    events = [capnp_log.Event.new_message(logMonoTime=i).to_bytes() for i in range(300)]
+    frames = [zstd.compress(b"".join(events[i:i + 100])) for i in range(0, len(events), 100)]
+    with tempfile.NamedTemporaryFile(suffix=".zst") as qlog:
+      with open(qlog.name, "wb") as f:
+        f.write(b"".join(frames))
+      assert [m.logMonoTime for m in LogReader(qlog.name)] == list(range(300))
+
+      with open(qlog.name, "wb") as f:
+        f.write(b"".join(frames)[:-10])
+      with pytest.warns(RuntimeWarning):
+        msgs = list(LogReader(qlog.name))
+      assert [m.logMonoTime for m in msgs] == list(range(200))
@@ -61,6 +61,7 @@ brew "llvm"
 brew "openssl@3.0"
 brew "qt@5"
 brew "zeromq"
+brew "zstd"
 cask "gcc-arm-embedded"
 brew "portaudio"
 EOS
@@ -53,7 +53,7 @@ DecoderManager decoder_manager;
 
 }  // namespace
 
-FrameReader::FrameReader() {
+FrameReader::FrameReader(bool shared_decoder) : shared_decoder(shared_decoder) {
   av_log_set_level(AV_LOG_QUIET);
 }
 
@@ -80,7 +80,12 @@ bool FrameReader::loadFromFile(CameraType type, const std::string &file, bool no
   }
   input_ctx->probesize = 10 * 1024 * 1024;  // 10MB
 
-  decoder_ = decoder_manager.acquire(type, input_ctx->streams[0]->codecpar, !no_hw_decoder);
+  if (shared_decoder) {
+    decoder_ = decoder_manager.acquire(type, input_ctx->streams[0]->codecpar, !no_hw_decoder);
+  } else {
+    own_decoder_ = std::make_unique<VideoDecoder>();
+    decoder_ = own_decoder_->open(input_ctx->streams[0]->codecpar, !no_hw_decoder) ? own_decoder_.get() : nullptr;
+  }
   if (!decoder_) {
     return false;
   }
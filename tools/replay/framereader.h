@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,7 +17,8 @@ class VideoDecoder;
 
 class FrameReader {
 public:
-  FrameReader();
+  // readers of the same camera share a decoder unless shared_decoder is false, e.g. to decode in parallel
+  FrameReader(bool shared_decoder = true);
   ~FrameReader();
   bool load(CameraType type, const std::string &url, bool no_hw_decoder = false, std::atomic<bool> *abort = nullptr, bool local_cache = false,
             int chunk_size = -1, int retries = 0);
@@ -26,7 +28,9 @@ public:
 
   int width = 0, height = 0;
 
+  const bool shared_decoder;
   VideoDecoder *decoder_ = nullptr;
+  std::unique_ptr<VideoDecoder> own_decoder_;
   AVFormatContext *input_ctx = nullptr;
   int prev_idx = -1;
   struct PacketInfo {
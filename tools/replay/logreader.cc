@@ -1,14 +1,46 @@
 #include "tools/replay/logreader.h"
 
 #include <algorithm>
+#include <fstream>
+#include <optional>
 #include <utility>
+#include "common/util.h"
+#include "system/loggerd/log_index.h"
 #include "tools/replay/filereader.h"
 #include "tools/replay/util.h"
 
+// Reads only the parts of a local uncompressed log that hold the filtered services, using the index written by loggerd.
+static std::optional<std::string> readIndexed(const std::string &file, const std::vector<bool> &filters) {
+  // any remote url (http, https) is read whole
+  if (filters.empty() || file.find("://") != std::string::npos || file.find(".bz2") != std::string::npos ||
+      file.find(".zst") != std::string::npos) {
+    return std::nullopt;
+  }
+  auto index = log_index::read(util::read_file(file + ".idx"));
+  if (index.empty()) return std::nullopt;
+
+  auto ranges = log_index::ranges(index, [&](uint16_t which) { return which < filters.size() && filters[which]; });
+  std::ifstream fs(file, std::ios::binary);
+  std::string data;
+  for (const auto &[offset, size] : ranges) {
+    size_t pos = data.size();
+    data.resize(pos + size);
+    fs.seekg(offset);
+    if (!fs.read(data.data() + pos, size)) return std::nullopt;
+  }
+  return data;
+}
+
 bool LogReader::load(const std::string &url, std::atomic<bool> *abort, bool local_cache, int chunk_size, int retries) {
+  if (auto indexed = readIndexed(url, filters_)) {
+    return !indexed->empty() && load(indexed->data(), indexed->size(), abort);
+  }
+
   std::string data = FileReader(local_cache, chunk_size, retries).read(url, abort);
   if (!data.empty() && url.find(".bz2") != std::string::npos)
     data = decompressBZ2(data, abort);
+  else if (!data.empty() && url.find(".zst") != std::string::npos)
+    data = decompressZST(data, abort);
 
   bool success = !data.empty() && load(data.data(), data.size(), abort);
   if (filters_.empty())
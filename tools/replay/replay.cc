@@ -159,9 +159,14 @@ void Replay::buildTimeline() {
     [(int)cereal::ControlsState::AlertStatus::CRITICAL] = TimelineType::AlertCritical,
   };
 
+  // only parse the services on the timeline and the thumbnails for qLogLoaded, local logs with an index are read partially
+  std::vector<bool> filters(sockets_.size(), false);
+  filters[cereal::Event::Which::CONTROLS_STATE] = filters[cereal::Event::Which::USER_FLAG] = true;
+  filters[cereal::Event::Which::THUMBNAIL] = true;
+
   const auto &route_segments = route_->segments();
   for (auto it = route_segments.cbegin(); it != route_segments.cend() && !exit_; ++it) {
-    std::shared_ptr<LogReader> log(new LogReader());
+    std::shared_ptr<LogReader> log(new LogReader(filters));
     if (!log->load(it->second.qlog.toStdString(), &exit_, !hasFlag(REPLAY_FLAG_NO_FILE_CACHE), 0, 3) || log->events.empty()) continue;
 
     std::vector<std::tuple<double, double, TimelineType>> timeline;
@@ -368,8 +373,8 @@ void Replay::startStream(const Segment *cur_segment) {
     builder.setRoot(event.getCarParams());
     auto words = capnp::messageToFlatArray(builder);
     auto bytes = words.asBytes();
-    Params().put("CarParams", (const char *)bytes.begin(), bytes.size());
-    Params().put("CarParamsPersistent", (const char *)bytes.begin(), bytes.size());
+    std::string car_params((const char *)bytes.begin(), bytes.size());
+    Params().putMany({{"CarParams", car_params}, {"CarParamsPersistent", car_params}});
   } else {
     rWarning("failed to read CarParams from current segment");
   }
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -174,3 +176,21 @@ TEST_CASE("seek_to") {
 
   loop.exec();
 }
+
+TEST_CASE("qLogLoaded") {
+  QEventLoop loop;
+  std::atomic<int> thumbnails = -1;
+  Replay replay(DEMO_ROUTE, {}, {}, nullptr, REPLAY_FLAG_NO_VIPC);
+
+  // the timeline reads the qlogs partially, cabana still needs the thumbnails
+  QObject::connect(&replay, &Replay::qLogLoaded, &replay, [&](std::shared_ptr<LogReader> qlog) {
+    thumbnails = std::count_if(qlog->events.begin(), qlog->events.end(),
+                               [](const Event &e) { return e.which == cereal::Event::Which::THUMBNAIL; });
+    QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+  }, Qt::DirectConnection);
+
+  REQUIRE(replay.load());
+  replay.start();
+  loop.exec();
+  REQUIRE(thumbnails > 0);
+}
@@ -0,0 +1,365 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "common/queue.h"
+#include "common/util.h"
+#include "system/loggerd/encoder/ffmpeg_encoder.h"
+#include "system/loggerd/logger.h"
+#include "system/loggerd/video_writer.h"
+#include "tools/replay/camera.h"
+#include "tools/replay/framereader.h"
+#include "tools/replay/logreader.h"
+
+// Re-encodes the video of logged segments, e.g. into qcamera proxies for many routes:
+//   tools/replay/transcode -o /tmp/proxies /data/media/0/realdata/<route>--{0..9}
+// Every output segment gets the new video and a copy of the segment's log with the encode index of the new video,
+// so it can be replayed like the source with --data_dir. Segments are transcoded by a pool of threads, one GOP of
+// the source video at a time. Each GOP is encoded by itself and the packets are written in order once the segment is done.
+
+constexpr int MAX_SEGMENTS_IN_FLIGHT = 2;  // segments loaded at once, their logs and encoded GOPs are kept in memory
+
+struct Camera {
+  const char *name;
+  CameraType type;
+  cereal::Event::Which idx;
+  EncoderInfo info;
+};
+
+const Camera CAMERAS[] = {
+  {"road", RoadCam, cereal::Event::ROAD_ENCODE_IDX, main_road_encoder_info},
+  {"wide", WideRoadCam, cereal::Event::WIDE_ROAD_ENCODE_IDX, main_wide_road_encoder_info},
+  {"driver", DriverCam, cereal::Event::DRIVER_ENCODE_IDX, main_driver_encoder_info},
+};
+
+struct Options {
+  const Camera *camera;
+  EncoderInfo info;           // the output
+  cereal::Event::Which idx;   // encode index event of the output
+  const char *codec;
+  std::string output;
+};
+
+struct Segment {
+  int id;
+  int num;
+  std::string path, out_path, log_name;
+  std::unique_ptr<LogReader> log;  // null if the segment has no log
+
+  struct Frame {
+    VisionIpcBufExtra extra;
+    uint64_t mono_time;
+    std::vector<kj::Array<capnp::word>> events;  // encoded by the GOP of the frame
+  };
+  std::vector<Frame> frames;
+  std::vector<std::pair<int, int>> gops;  // [begin, end) frames, each starts with a keyframe
+  std::atomic<int> remaining_gops = 0;
+  std::atomic<bool> failed = false;
+};
+
+struct Job {
+  std::shared_ptr<Segment> segment;
+  int gop;
+};
+
+std::string find_file(const std::string &path, const std::vector<std::string> &names) {
+  for (const auto &name : names) {
+    if (util::file_exists(path + "/" + name)) return name;
+  }
+  return "";
+}
+
+// reads the source frame metadata and the GOPs of the video, returns false if the segment has no video
+bool load_segment(const Options &opts, Segment *seg) {
+  FrameReader fr(false);
+  if (!fr.loadFromFile(opts.camera->type, seg->path + "/" + opts.camera->info.filename, true)) {
+    rError("%s: failed to load %s", seg->path.c_str(), opts.camera->info.filename);
+    return false;
+  }
+
+  seg->frames.resize(fr.getFrameCount());
+  for (size_t i = 0; i < seg->frames.size(); ++i) {
+    // without a log the frames are numbered and timed as encoderd would
+    seg->frames[i].extra = {.frame_id = (uint32_t)i, .timestamp_eof = i * 50000000ULL};
+    seg->frames[i].mono_time = seg->frames[i].extra.timestamp_eof;
+    if (i == 0 || (fr.packets_info[i].flags & AV_PKT_FLAG_KEY)) {
+      seg->gops.push_back({(int)i, (int)i});
+    }
+    seg->gops.back().second = (int)i + 1;
+  }
+
+  const std::string log = find_file(seg->path, {"rlog", "rlog.zst", "rlog.bz2", "qlog", "qlog.zst", "qlog.bz2"});
+  seg->log_name = (log.empty() ? "rlog" : log.substr(0, 4)) + ".zst";
+  if (!log.empty()) {
+    seg->log = std::make_unique<LogReader>();
+    if (!seg->log->load(seg->path + "/" + log)) {
+      rWarning("%s: failed to load %s", seg->path.c_str(), log.c_str());
+      seg->log.reset();
+    }
+  }
+  if (seg->log) {
+    for (const auto &e : seg->log->events) {
+      if (e.which != opts.camera->idx || e.eidx_segnum != -1) continue;
+
+      capnp::FlatArrayMessageReader reader(e.data);
+      auto event = reader.getRoot<cereal::Event>();
+      auto idx = capnp::AnyStruct::Reader(event).getPointerSection()[0].getAs<cereal::EncodeIndex>();
+      if (idx.getSegmentId() < seg->frames.size()) {
+        auto &f = seg->frames[idx.getSegmentId()];
+        f.extra = {.frame_id = idx.getFrameId(), .timestamp_sof = idx.getTimestampSof(), .timestamp_eof = idx.getTimestampEof()};
+        f.mono_time = e.mono_time;
+      }
+    }
+  } else {
+    rWarning("%s: no log, writing only the encode index", seg->path.c_str());
+  }
+  return true;
+}
+
+// writes the video and the log of a transcoded segment
+void write_segment(const Options &opts, Segment *seg) {
+  util::create_directories(seg->out_path, 0775);
+
+  std::unique_ptr<VideoWriter> writer;
+  uint32_t encode_id = 0;
+  for (auto &f : seg->frames) {
+    std::vector<kj::Array<capnp::word>> idx_events;
+    for (const auto &data : f.events) {
+      capnp::FlatArrayMessageReader reader(data);
+      auto event = reader.getRoot<cereal::Event>();
+      auto edata = (event.*(opts.info.get_encode_data_func))();
+      auto idx = edata.getIdx();
+      if (!writer) {
+        writer.reset(new VideoWriter(seg->out_path.c_str(), opts.info.filename, idx.getType() != cereal::EncodeIndex::Type::FULL_H_E_V_C,
+                                     edata.getWidth(), edata.getHeight(), opts.info.fps, idx.getType()));
+        auto header = edata.getHeader();
+        writer->write((uint8_t *)header.begin(), header.size(), idx.getTimestampEof()/1000, true, false);
+      }
+      auto dat = edata.getData();
+      writer->write((uint8_t *)dat.begin(), dat.size(), idx.getTimestampEof()/1000, false, idx.getFlags() & V4L2_BUF_FLAG_KEYFRAME);
+
+      // the idx packet as loggerd would log it, numbered across the GOPs
+      MessageBuilder msg;
+      auto evt = msg.initEvent(event.getValid());
+      evt.setLogMonoTime(f.mono_time);
+      (evt.*(opts.info.set_encode_idx_func))(idx);
+      auto new_idx = (evt.*(opts.info.get_encode_idx_func))();
+      new_idx.setEncodeId(encode_id);
+      new_idx.setSegmentId(encode_id);
+      new_idx.setSegmentNum(seg->num);
+      ++encode_id;
+      idx_events.push_back(capnp::messageToFlatArray(msg));
+    }
+    f.events = std::move(idx_events);
+  }
+  writer.reset();
+
+  ZstdFile log(seg->out_path + "/" + seg->log_name);
+  auto write_frame = [&](size_t i) {
+    for (auto &data : seg->frames[i].events) log.write(data.asBytes());
+  };
+  if (seg->log) {
+    // the source log with the new encode index after the index of each source frame
+    for (const auto &e : seg->log->events) {
+      if (e.eidx_segnum != -1) continue;  // added by LogReader for the video stream
+      if (e.which == opts.camera->idx) {
+        if (opts.idx != opts.camera->idx) log.write((void *)e.data.begin(), e.data.size() * sizeof(capnp::word));
+        capnp::FlatArrayMessageReader reader(e.data);
+        auto idx = capnp::AnyStruct::Reader(reader.getRoot<cereal::Event>()).getPointerSection()[0].getAs<cereal::EncodeIndex>();
+        if (idx.getSegmentId() < seg->frames.size()) write_frame(idx.getSegmentId());
+      } else if (e.which != opts.idx) {
+        log.write((void *)e.data.begin(), e.data.size() * sizeof(capnp::word));
+      }
+    }
+  } else {
+    for (size_t i = 0; i < seg->frames.size(); ++i) write_frame(i);
+  }
+}
+
+void transcode_thread(const Options &opts, SafeQueue<Job> &jobs, const std::function<void(Segment *)> &segment_done) {
+  util::set_thread_name("transcode");
+  std::unique_ptr<FrameReader> fr;
+  std::unique_ptr<FfmpegEncoder> encoder;
+  int fr_segment = -1;
+  VisionBuf buf = {};
+
+  Segment::Frame *cur_frame = nullptr;
+  auto output = [&](MessageBuilder &msg) {
+    // none of the outputs have thumbnails, only the video packets are kept
+    if (msg.getRoot<cereal::Event>().isThumbnail()) return;
+    cur_frame->events.push_back(capnp::messageToFlatArray(msg));
+  };
+
+  while (true) {
+    Job job = jobs.pop();
+    if (!job.segment) break;
+    Segment *seg = job.segment.get();
+
+    if (fr_segment != seg->id && !seg->failed) {
+      fr_segment = seg->id;
+      fr = std::make_unique<FrameReader>(false);
+      if (fr->loadFromFile(opts.camera->type, seg->path + "/" + opts.camera->info.filename, true)) {
+        if ((int)buf.width != fr->width || (int)buf.height != fr->height) {
+          if (buf.addr) buf.free();
+          auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(fr->width, fr->height);
+          buf.allocate(nv12_buffer_size);
+          buf.init_yuv(fr->width, fr->height, nv12_width, nv12_width * nv12_height);
+        }
+        encoder = std::make_unique<FfmpegEncoder>(opts.info, fr->width, fr->height, opts.codec, true);
+        encoder->set_output(output);
+      } else {
+        rError("%s: failed to load %s", seg->path.c_str(), opts.camera->info.filename);
+        seg->failed = true;
+      }
+    }
+
+    if (!seg->failed) {
+      // each GOP is encoded by itself, the output starts with a keyframe too
+      auto [begin, end] = seg->gops[job.gop];
+      encoder->encoder_open(nullptr);
+      for (int i = begin; i < end; ++i) {
+        cur_frame = &seg->frames[i];
+        if (!fr->get(i, &buf)) {
+          rWarning("%s: failed to decode frame %d", seg->path.c_str(), i);
+          continue;
+        }
+        // EncoderFrame only converts the buffer while it holds the frame
+        buf.set_frame_id(cur_frame->extra.frame_id);
+        EncoderFrame frame(&buf, cur_frame->extra);
+        if (encoder->encode_frame(&frame) < 0) {
+          rWarning("%s: failed to encode frame %d", seg->path.c_str(), i);
+        }
+      }
+      encoder->encoder_close();
+    }
+
+    if (--seg->remaining_gops == 0) {
+      if (!seg->failed) write_segment(opts, seg);
+      segment_done(seg);
+    }
+  }
+  if (buf.addr) buf.free();
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Re-encode the video of logged segments, into qcamera-style proxies by default.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("segments", "segment directories, e.g. /data/media/0/realdata/<route>--0", "segments...");
+  parser.addOption({{"o", "output"}, "directory the transcoded segments are written to", "dir"});
+  parser.addOption({"camera", "camera to transcode: road, wide or driver. default is road", "camera", "road"});
+  parser.addOption({"hevc", "re-encode into the camera's hevc file instead of a qcamera"});
+  parser.addOption({"bitrate", "output bitrate in bits/s", "bitrate"});
+  parser.addOption({"width", "qcamera width", "width"});
+  parser.addOption({"height", "qcamera height", "height"});
+  parser.addOption({{"j", "threads"}, "number of threads. default is one per core", "n"});
+  parser.process(app);
+
+  const QStringList segments = parser.positionalArguments();
+  if (segments.empty() || !parser.isSet("output")) {
+    parser.showHelp(1);
+  }
+
+  Options opts = {.output = parser.value("output").toStdString()};
+  for (const auto &c : CAMERAS) {
+    if (parser.value("camera") == c.name) opts.camera = &c;
+  }
+  if (!opts.camera) {
+    fprintf(stderr, "unknown camera %s\n", parser.value("camera").toStdString().c_str());
+    return 1;
+  }
+  if (parser.isSet("hevc")) {
+    opts.info = opts.camera->info;
+    opts.info.encode_type = cereal::EncodeIndex::Type::FULL_H_E_V_C;
+    opts.idx = opts.camera->idx;
+    opts.codec = "libx265";
+  } else {
+    if (opts.camera->type != RoadCam) {
+      fprintf(stderr, "qcameras are only made from the road camera, use --hevc\n");
+      return 1;
+    }
+    opts.info = qcam_encoder_info;
+    opts.idx = cereal::Event::Q_ROAD_ENCODE_IDX;
+    opts.codec = "libx264";
+    if (parser.isSet("width")) opts.info.frame_width = parser.value("width").toInt() & ~1;
+    if (parser.isSet("height")) opts.info.frame_height = parser.value("height").toInt() & ~1;
+  }
+  if (!avcodec_find_encoder_by_name(opts.codec)) {
+    fprintf(stderr, "ffmpeg was built without the %s encoder\n", opts.codec);
+    return 1;
+  }
+  if (parser.isSet("bitrate")) opts.info.bitrate = parser.value("bitrate").toInt();
+  const int num_threads = std::max(1, parser.isSet("threads") ? parser.value("threads").toInt()
+                                                              : (int)std::thread::hardware_concurrency());
+
+  std::mutex lock;
+  std::condition_variable cv;
+  int in_flight = 0, done = 0, failed = 0;
+  size_t frames = 0;
+  std::function<void(Segment *)> segment_done = [&](Segment *seg) {
+    std::lock_guard lk(lock);
+    --in_flight;
+    ++(seg->failed ? failed : done);
+    frames += seg->failed ? 0 : seg->frames.size();
+    rInfo("%s: %s", seg->path.c_str(), seg->failed ? "failed" : seg->out_path.c_str());
+    cv.notify_all();
+  };
+
+  SafeQueue<Job> jobs;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(transcode_thread, std::cref(opts), std::ref(jobs), std::cref(segment_done));
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < segments.size(); ++i) {
+    {
+      std::unique_lock lk(lock);
+      cv.wait(lk, [&]() { return in_flight < MAX_SEGMENTS_IN_FLIGHT; });
+    }
+
+    auto seg = std::make_shared<Segment>();
+    seg->id = i;
+    seg->path = segments[i].toStdString();
+    while (seg->path.size() > 1 && seg->path.back() == '/') seg->path.pop_back();
+    const std::string name = seg->path.substr(seg->path.find_last_of('/') + 1);
+    const size_t pos = name.rfind("--");
+    seg->num = pos != std::string::npos ? std::atoi(name.c_str() + pos + 2) : 0;
+    seg->out_path = opts.output + "/" + name;
+    if (!load_segment(opts, seg.get()) || seg->gops.empty()) {
+      std::lock_guard lk(lock);
+      ++failed;
+      continue;
+    }
+
+    {
+      std::lock_guard lk(lock);
+      ++in_flight;
+    }
+    seg->remaining_gops = seg->gops.size();
+    for (int g = 0; g < (int)seg->gops.size(); ++g) {
+      jobs.push({seg, g});
+    }
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    jobs.push({nullptr, 0});
+  }
+  for (auto &t : threads) t.join();
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  rInfo("transcoded %d segments, %zu frames in %.1fs (%.1f frames/s), %d failed", done, frames, seconds, frames / seconds, failed);
+  return failed > 0;
+}
@@ -3,6 +3,7 @@
 #include <bzlib.h>
 #include <curl/curl.h>
 #include <openssl/sha.h>
+#include <zstd.h>
 
 #include <cassert>
 #include <algorithm>
@@ -14,10 +15,12 @@
 #include <map>
 #include <mutex>
 #include <numeric>
+#include <thread>
 #include <utility>
 
 #include "common/timing.h"
 #include "common/util.h"
+#include "system/loggerd/zstd_index.h"
 
 ReplayMessageHandler message_handler = nullptr;
 void installMessageHandler(ReplayMessageHandler handler) { message_handler = handler; }
@@ -318,6 +321,84 @@ std::string decompressBZ2(const std::byte *in, size_t in_size, std::atomic<bool>
   return {};
 }
 
+std::string decompressZST(const std::string &in, std::atomic<bool> *abort) {
+  return decompressZST((std::byte *)in.data(), in.size(), abort);
+}
+
+// Decompresses the frames one after another. Logs that were cut off before loggerd wrote the index
+// are read up to the last complete frame.
+static std::string decompressZSTStream(const std::byte *in, size_t in_size, std::atomic<bool> *abort) {
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  assert(dctx != nullptr);
+
+  std::string out(in_size * 5, '\0');
+  ZSTD_inBuffer input = {in, in_size, 0};
+  ZSTD_outBuffer output = {out.data(), out.size(), 0};
+  size_t ret = 0, frames_end = 0;
+  do {
+    if (output.pos == output.size) {
+      out.resize(out.size() * 2);
+      output.dst = out.data();
+      output.size = out.size();
+    }
+    ret = ZSTD_decompressStream(dctx, &output, &input);
+    if (ZSTD_isError(ret)) {
+      rWarning("decompressZST error : %s", ZSTD_getErrorName(ret));
+      break;
+    }
+    if (ret == 0) frames_end = output.pos;
+  } while ((input.pos < input.size || output.pos == output.size) && !(abort && *abort));
+
+  ZSTD_freeDCtx(dctx);
+  if (abort && *abort) return {};
+  if (!ZSTD_isError(ret) && ret != 0) {
+    rWarning("decompressZST : log is truncated, read up to the last complete frame");
+  }
+
+  out.resize(frames_end);
+  out.shrink_to_fit();
+  return out;
+}
+
+std::string decompressZST(const std::byte *in, size_t in_size, std::atomic<bool> *abort) {
+  const auto frames = zstd_index::read((const char *)in, in_size);
+  if (frames.empty()) {
+    // no index, not written by loggerd or the segment was not closed
+    return decompressZSTStream(in, in_size, abort);
+  }
+
+  std::vector<size_t> out_offsets;
+  size_t out_size = 0;
+  for (const auto &f : frames) {
+    out_offsets.push_back(out_size);
+    out_size += f.decompressed_size;
+  }
+
+  // frames are independent, decompress them in parallel
+  std::string out(out_size, '\0');
+  std::atomic<size_t> next_frame = 0;
+  std::atomic<bool> failed = false;
+  auto decompress_frames = [&]() {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    for (size_t i = next_frame++; i < frames.size() && !failed && !(abort && *abort); i = next_frame++) {
+      const auto &f = frames[i];
+      size_t ret = ZSTD_decompressDCtx(dctx, &out[out_offsets[i]], f.decompressed_size, in + f.offset, f.compressed_size);
+      if (ZSTD_isError(ret) || ret != f.decompressed_size) failed = true;
+    }
+    ZSTD_freeDCtx(dctx);
+  };
+  std::vector<std::thread> threads(std::min<size_t>(frames.size(), std::max(1u, std::thread::hardware_concurrency())) - 1);
+  for (auto &t : threads) t = std::thread(decompress_frames);
+  decompress_frames();
+  for (auto &t : threads) t.join();
+
+  if (failed) {
+    rWarning("decompressZST error : content is corrupt");
+    return {};
+  }
+  return (abort && *abort) ? std::string() : out;
+}
+
 void precise_nano_sleep(int64_t nanoseconds, std::atomic<bool> &should_exit) {
   struct timespec req, rem;
   req.tv_sec = nanoseconds / 1000000000;